@@ -1,24 +1,45 @@
 #include <Eigen/Dense>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <numeric>
 #include <cmath>
-#include <set>
 #include <chrono>
 #include <algorithm>
+#include <climits>
+#include <array>
+#include <iomanip>
 #include "beam_search.h"
 #include "nnet.h"
 #include "node.h"
+#include "bounds.h"
 #include "instance.h"
 
+#ifdef _OPENMP
+    #include <omp.h>
+#endif
+
 using namespace std;
 
-double running_time = 0.0;
-std::vector<int> solution;
+int thread_num() {
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+int team_size() {
+#ifdef _OPENMP
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
 
-bool validate_solution(Instance* inst) {
+bool validate_solution(Instance* inst, const std::vector<int>& solution) {
     if (solution.empty()) return false;
 
     // input strings: solution must be a subsequence of each S[i]
@@ -54,24 +75,36 @@ size_t count = 0;
     return true;
 }
 
-void save_in_file(const std::string& outfile, Instance* inst) {
-    // Clean file name
+// Base name of an instance path, without directories and extension
+static string clean_name(const string& file_name) {
     string clean_file_name;
-    size_t bar_count = count(inst->file_name.begin(), inst->file_name.end(), '/');
+    size_t bar_count = count(file_name.begin(), file_name.end(), '/');
     size_t count = 0;
-    for (char c : inst->file_name) {
+    for (char c : file_name) {
         if (count == bar_count && c == '.') break;
         if (count == bar_count) clean_file_name.push_back(c);
         else if (c == '/') count++;
     }
+    return clean_file_name;
+}
+
+void write_result(std::ostream& out, Instance* inst, const BSResult& result) {
+    out << clean_name(inst->file_name) << std::endl;
+    out << "Objective: " << result.solution.size() << std::endl;
+    out << "Solution: ";
+    for (auto& c : result.solution) out << inst->int2char[c] << " ";
+    out << "\nTime: " << result.time << std::endl;
+    out << "Feasible: " << validate_solution(inst, result.solution) << std::endl;
+}
 
+void write_error(std::ostream& out, const std::string& file_name, const std::string& message) {
+    out << clean_name(file_name) << std::endl;
+    out << message << std::endl;
+}
+
+void save_in_file(const std::string& outfile, Instance* inst, const BSResult& result) {
     if (outfile.empty()) {
-        std::cout << clean_file_name << std::endl;
-        std::cout << "Objective: " << solution.size() << std::endl;
-        std::cout << "Solution: ";
-        for (auto& c : solution) std::cout << inst->int2char[c] << " ";
-        std::cout << "\nTime: " << running_time << std::endl;
-        std::cout << "Feasible: " << validate_solution(inst) << std::endl;
+        write_result(std::cout, inst, result);
         return;
     }
     // Save to file
@@ -80,138 +113,400 @@ void save_in_file(const std::string& outfile, Instance* inst) {
         std::cerr << "Error opening the file." << std::endl;
         return;
     }
-
-    outputFile << clean_file_name << std::endl;
-    outputFile << "Objective: " << solution.size() << std::endl;
-    outputFile << "Solution: ";
-    for (auto& c : solution) outputFile << inst->int2char[c] << " ";
-    outputFile << "\nTime: " << running_time << std::endl;
-    outputFile << "Feasible: " << validate_solution(inst) << std::endl;
-}
-
-double compute_max(const vector<double>& values) {
-    return *max_element(values.begin(), values.end());
-}
-
-double compute_min(const vector<double>& values) {
-    return *min_element(values.begin(), values.end());
-}
-
-double compute_average(const vector<double>& values) {
-    return accumulate(values.begin(), values.end(), 0.0) / values.size();
+    write_result(outputFile, inst, result);
 }
 
-double compute_std(const vector<double>& values, double mean) {
-    double sum_sq = 0.0;
-    for (double v : values)
-        sum_sq += (v - mean) * (v - mean);
-    return sqrt(sum_sq / values.size());
+int features_per_node(int feature_config) {
+    int n = 9;
+    if (feature_config >= 2) n += 1;
+    if (feature_config >= 3) n += 2;
+    if (feature_config == 4) n += 2;
+    return n;
 }
 
-void standardize(vector<double>& features) {
-    double avg = compute_average(features);
-    double std_dev = compute_std(features, avg);
-    for (double& f : features)
-        f = (f - avg) / std_dev;
+// Max, min, average and std of x[0, n), written to out[0, 4). The sum and the
+// squared deviations are accumulated in index order, as separate passes over a
+// vector would. Empty ranges (no R strings) give zeros.
+static inline void summarize(const double* x, int n, double* out) {
+    if (n == 0) {
+        fill_n(out, 4, 0.0);
+        return;
+    }
+    double max_v = x[0], min_v = x[0], sum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        max_v = max(max_v, x[i]);
+        min_v = min(min_v, x[i]);
+        sum += x[i];
+    }
+    double mean = sum / n, sum_sq = 0.0;
+    for (int i = 0; i < n; ++i)
+        sum_sq += (x[i] - mean) * (x[i] - mean);
+    out[0] = max_v;
+    out[1] = min_v;
+    out[2] = mean;
+    out[3] = sqrt(sum_sq / n);
 }
 
-void compute_features(vector<Node*>& V_ext, int feature_config) {
-    for (Node* node : V_ext) {
-        vector<double> pL_v(get<0>(node->position).begin(), get<0>(node->position).end());
-        vector<double> lv(get<2>(node->position).begin(), get<2>(node->position).end());
-
-        // normalize left position vectors with respect to input and restricted strings lengths
-        for (size_t i = 0; i < pL_v.size(); ++i) pL_v[i] /= node->inst->S[i].size();
-        for (size_t i = 0; i < lv.size(); ++i) lv[i] /= node->inst->R[i].size();
-
-        vector<double> features = {
-            compute_max(pL_v), compute_min(pL_v), compute_average(pL_v), compute_std(pL_v, compute_average(pL_v)),
-            compute_max(lv), compute_min(lv), compute_average(lv), compute_std(lv, compute_average(lv)),
-            static_cast<double>(node->l_v)
-        };
-
-        if (feature_config >= 2) features.push_back(node->inst->Sigma);
+// features of the node V_ext[kept[j]] are stored in features[j * n_features, (j + 1) * n_features),
+// computed here for j in [begin, end). The normalized positions of a node go to a
+// per-thread buffer and are summarized and standardized in place, so nothing is
+// allocated per node.
+void compute_features(const NodeLevel& V_ext, const vector<int>& kept, size_t begin, size_t end,
+                      int l_v, Instance* inst, int feature_config, vector<double>& features) {
+    const int n_features = features_per_node(feature_config);
+    const int m = inst->m, p = inst->p, r = inst->r;
+
+    // string lengths as doubles (S strings, then R strings) and the normalized positions of a node
+    thread_local vector<double> lengths, normalized;
+    lengths.resize(m + r);
+    normalized.resize(m + r);
+    for (int i = 0; i < m; ++i) lengths[i] = inst->S[i].size();
+    for (int k = 0; k < r; ++k) lengths[m + k] = inst->R[k].size();
+
+    for (size_t j = begin; j < end; ++j) {
+        const int* position = V_ext.position(kept[j]);
+        const int* rleft = position + m + p;
+        double* f = features.data() + j * n_features;
+
+        // left position vectors normalized with respect to input and restricted strings lengths
+        for (int i = 0; i < m; ++i) normalized[i] = position[i] / lengths[i];
+        for (int k = 0; k < r; ++k) normalized[m + k] = rleft[k] / lengths[m + k];
+
+        summarize(normalized.data(), m, f);
+        summarize(normalized.data() + m, r, f + 4);
+        f[8] = l_v;
+
+        if (feature_config >= 2) f[9] = inst->Sigma;
         if (feature_config >= 3) {
-            features.push_back(node->inst->m);
-            features.push_back(node->inst->r);
+            f[10] = inst->m;
+            f[11] = inst->r;
         }
         if (feature_config == 4) {
-            features.push_back(node->inst->S[0].size()); // assumes uniform input length
-            features.push_back(node->inst->R[0].size());
+            f[12] = inst->S[0].size(); // assumes uniform input length
+            f[13] = (r > 0) ? inst->R[0].size() : 0;
         }
 
-        standardize(features);
-        node->features = features;
+        // standardize the node's features
+        double avg = 0.0, sum_sq = 0.0;
+        for (int c = 0; c < n_features; ++c) avg += f[c];
+        avg /= n_features;
+        for (int c = 0; c < n_features; ++c) sum_sq += (f[c] - avg) * (f[c] - avg);
+        double std_dev = sqrt(sum_sq / n_features);
+        for (int c = 0; c < n_features; ++c) f[c] = (f[c] - avg) / std_dev;
     }
 }
 
-void compute_heuristic_values(vector<Node*>& V_ext, MLP& neural_network) {
-    for (Node* node : V_ext) {
-        Eigen::Map<const Eigen::VectorXd> eigen_features(node->features.data(), node->features.size());
-        node->heuristic_value = neural_network.forward(eigen_features)(0);
-    }
+// heuristic_values[j] for j in [begin, end), from the features of compute_features()
+void compute_heuristic_values(const vector<double>& features, size_t begin, size_t end, MLP& neural_network,
+                              vector<Eigen::MatrixXd>& layer_outputs, vector<double>& heuristic_values) {
+    const int n_features = features_per_node(neural_network.feature_config);
+    if (begin == end) return;
+
+    Eigen::Map<const Eigen::MatrixXd> eigen_features(features.data() + begin * n_features, n_features, end - begin);
+    const Eigen::MatrixXd& output = neural_network.forward_batch(eigen_features, layer_outputs);
+    for (size_t j = begin; j < end; ++j)
+        heuristic_values[j] = output(0, j - begin);
 }
 
-double BS(double t_lim, int beta, Instance* inst, MLP& neural_network, bool training) {
-    std::vector<int> pL(inst->m, 0), ppl(inst->p, 0), rpl(inst->r, 0);
-    Node* root = new Node(inst, pL, ppl, rpl);
+// Indices of the beta best heuristic values, best first. Ties are broken by the
+// lower index (extension set order), so the beam is reproducible. Only the beta
+// winners are sorted; the rest are partitioned away by nth_element.
+void select_best(const vector<double>& heuristic_values, int beta, vector<int>& selected) {
+    selected.resize(heuristic_values.size());
+    iota(selected.begin(), selected.end(), 0);
+
+    auto better = [&heuristic_values](int a, int b) {
+        if (heuristic_values[a] != heuristic_values[b])
+            return heuristic_values[a] > heuristic_values[b];
+        return a < b;
+    };
+
+    if (selected.size() > static_cast<size_t>(beta)) {
+        nth_element(selected.begin(), selected.begin() + beta, selected.end(), better);
+        selected.resize(beta);
+    }
+    sort(selected.begin(), selected.end(), better);
+}
 
-    vector<Node*> beam = {root}, to_delete = {root};
-    Node* best_node = root;
-    int l_best = 0;
+// Each level is expanded by n_threads threads, each taking a contiguous chunk of
+// the beam with its own NodeExpander. Dedup is partitioned by hash, and features
+// and inference are split over contiguous chunks of the extension set, so the
+// result does not depend on the number of threads.
+//
+// With a memory_limit (bytes, 0 = none), the beam width is lowered whenever the
+// estimated memory of the search passes 90% of it: the retained levels plus the
+// working set of the last level (extension set, features), which scales with beta.
+//
+// With an upper_bound level, children that pass dedup but whose UpperBound shows
+// they cannot end longer than max(l_best, incumbent) are dropped before feature
+// computation and inference; the search stops once no child is left. Within a
+// single run l_best is always below the level being built, so the pruning bites
+// when an incumbent is given, as anytime_BS() does for its later runs.
+//
+// With dominance_references, the remaining children are also checked for dominance
+// against children of other parents (see DominanceFilter) before being scored, in
+// O(dominance_references) checks per child.
+//
+// With a node_budget, the search stops after the level at which the number of
+// expanded beam nodes reaches it. Unlike the time limit, this gives the same
+// result for any machine load and number of threads.
+//
+// With level_stats, one LevelStats record per level is appended to it. Phase times
+// are wall times: expansion and dedup up to the barrier ending them, features and
+// inference of the slowest thread. Without it, no clock is read inside a level.
+BSResult BS(double t_lim, int beta, Instance* inst, MLP& neural_network, const BSOptions& options) {
+    BSResult result;
+    NodePool pool(inst);
+    const int n_threads = max(options.n_threads, 1);
+    const size_t memory_limit = options.memory_limit;
+    std::vector<LevelStats>* level_stats = options.level_stats;
+
+    // per-thread state
+    vector<NodeExpander> expanders(n_threads, NodeExpander(pool));
+    vector<NodeHashSet> seen_nodes(n_threads, NodeHashSet(inst->m, inst->p));
+    vector<UpperBound> upper_bounds(n_threads, UpperBound(inst, options.upper_bound));
+    vector<long long> bound_pruned(n_threads);
+    DominanceFilter dominance(inst->m, inst->p, pool.stride, options.dominance_references);
+    size_t undominated = 0; // children left for the dominance filter
+    vector<vector<Eigen::MatrixXd>> layer_outputs(n_threads);
+    vector<int> first_complete(n_threads); // first childless complete beam node met by each thread
+    vector<array<double, 4>> phase_ns(n_threads); // expansion, dedup, features, inference
+
+    const bool profile = level_stats != nullptr;
+    using clock = chrono::steady_clock;
+    auto clock_now = [profile]() { return profile ? clock::now() : clock::time_point(); };
+    auto ns_between = [](clock::time_point a, clock::time_point b) { return chrono::duration<double, nano>(b - a).count(); };
+
+    // with a single thread the expander's children already are the extension set
+    NodeLevel& V_ext = (n_threads == 1) ? expanders[0].children : pool.candidates;
+
+    const int n_features = features_per_node(neural_network.feature_config);
+    int l_best = 0, best_idx = 0;
+    vector<size_t> offsets(n_threads + 1);
+    vector<char> keep;
+    vector<int> kept, selected;
+    vector<double> features, heuristic_values;
 
     auto start_time = chrono::high_resolution_clock::now();
-    set<tuple<vector<int>, vector<int>>> seen_nodes;
 
-    while (!beam.empty()) {
-        vector<Node*> V_ext;
+    for (int l = 0; !pool.levels[l].empty(); ++l) {
+        const NodeLevel& beam = pool.levels[l];
+        result.levels = l + 1;
+        const size_t expanded_nodes = beam.size();
+        result.nodes_expanded += expanded_nodes;
+        result.max_beam_size = max(result.max_beam_size, static_cast<int>(beam.size()));
+        fill(first_complete.begin(), first_complete.end(), INT_MAX);
+        const int target = max(l_best, options.incumbent); // length a child must be able to beat
+        long long dominated_before = 0;
+        for (const auto& expander : expanders) dominated_before += expander.dominated_letters;
+
+        #pragma omp parallel num_threads(n_threads)
+        {
+            const int t = thread_num(), T = team_size();
+            NodeExpander& expander = expanders[t];
+            auto t0 = clock_now();
+
+            expander.children.clear();
+            for (size_t idx = beam.size() * t / T; idx < beam.size() * (t + 1) / T; ++idx) {
+                size_t first_child = expander.children.size();
+                expander.expansion(l, idx);
+
+                if (expander.children.size() == first_child && first_complete[t] == INT_MAX &&
+                    pool.is_complete(beam.position(idx)))
+                    first_complete[t] = idx;
+            }
 
-        for (Node* node : beam) {
-            auto children = node->expansion();
-            if (children.empty() && node->l_v > l_best && node->is_complete()) {
-                l_best = node->l_v;
-                best_node = node;
+            // concatenate the children in thread order, i.e. in beam order
+            if (n_threads > 1) {
+                #pragma omp barrier
+                #pragma omp single
+                {
+                    for (int i = 0; i < T; ++i)
+                        offsets[i + 1] = offsets[i] + expanders[i].children.size();
+                    V_ext.resize(offsets[T]);
+                }
+                V_ext.copy_nodes(expander.children, offsets[t]);
             }
 
-            for (Node* child : children) {
-                auto key = make_tuple(get<0>(child->position), get<2>(child->position));
-                if (seen_nodes.insert(key).second) {
-                    V_ext.push_back(child);
-                } else {
-                    delete child;
+            // duplicate detection on (S positions, R positions): each thread owns the
+            // nodes of one hash partition and keeps their first occurrence
+            #pragma omp barrier
+            auto t1 = clock_now();
+            #pragma omp single
+            keep.assign(V_ext.size(), 0);
+
+            NodeHashSet& seen = seen_nodes[t];
+            seen.reset();
+            bound_pruned[t] = 0;
+            for (size_t idx = 0; idx < V_ext.size(); ++idx) {
+                if ((V_ext.hashes[idx] >> 32) % T != static_cast<uint64_t>(t) || !seen.insert(V_ext, idx))
+                    continue;
+                // children that cannot end longer than the incumbent are dropped unscored
+                if (options.upper_bound > 0 && l + 1 + upper_bounds[t](V_ext.position(idx)) <= target) {
+                    ++bound_pruned[t];
+                    continue;
                 }
+                keep[idx] = 1;
             }
-        }
 
-        compute_features(V_ext, neural_network.feature_config);
-        compute_heuristic_values(V_ext, neural_network);
+            #pragma omp barrier
+            if (options.dominance_references > 0) {
+                #pragma omp single
+                {
+                    kept.clear();
+                    for (size_t idx = 0; idx < V_ext.size(); ++idx)
+                        if (keep[idx]) kept.push_back(idx);
+                    undominated = kept.size();
+                    dominance.select_references(V_ext, kept, keep);
+                }
 
-        sort(V_ext.begin(), V_ext.end(),
-            [](Node* a, Node* b) { return a->heuristic_value > b->heuristic_value; });
+                size_t n = dominance.n_pending();
+                for (size_t i = n * t / T; i < n * (t + 1) / T; ++i) {
+                    int idx = dominance.pending(i);
+                    if (dominance.dominated(V_ext, idx))
+                        keep[idx] = 0;
+                }
+                #pragma omp barrier
+            }
 
-        beam.clear();
-        for (size_t i = 0; i < min(V_ext.size(), static_cast<size_t>(beta)); ++i) {
-            beam.push_back(V_ext[i]);
-            to_delete.push_back(V_ext[i]);
+            #pragma omp single
+            {
+                kept.clear();
+                for (size_t idx = 0; idx < V_ext.size(); ++idx)
+                    if (keep[idx]) kept.push_back(idx);
+                features.resize(kept.size() * n_features);
+                heuristic_values.resize(kept.size());
+            }
+
+            auto t2 = clock_now();
+            size_t begin = kept.size() * t / T, end = kept.size() * (t + 1) / T;
+            compute_features(V_ext, kept, begin, end, l + 1, inst, neural_network.feature_config, features);
+            auto t3 = clock_now();
+            compute_heuristic_values(features, begin, end, neural_network, layer_outputs[t], heuristic_values);
+
+            if (profile)
+                phase_ns[t] = {ns_between(t0, t1), ns_between(t1, t2), ns_between(t2, t3), ns_between(t3, clock_now())};
+        }
+
+        auto first = min_element(first_complete.begin(), first_complete.end());
+        if (*first != INT_MAX && l > l_best) {
+            l_best = l;
+            best_idx = *first;
         }
 
-        for (size_t i = beta; i < V_ext.size(); ++i)
-            delete V_ext[i];
+        long long level_bound_pruned = accumulate(bound_pruned.begin(), bound_pruned.end(), 0LL);
+        result.bound_pruned += level_bound_pruned;
+        long long level_dominated = (options.dominance_references > 0) ? undominated - kept.size() : 0;
+        result.dominated_nodes += level_dominated;
+
+        auto selection_start = clock_now();
+        select_best(heuristic_values, beta, selected);
+        for (int& j : selected)
+            j = kept[j];
+        auto commit_start = clock_now();
+        pool.commit(V_ext, selected); // the unselected candidates are dropped with the next clear()
+
+        if (profile) {
+            LevelStats stats;
+            stats.level = l;
+            stats.beam_size = expanded_nodes;
+            stats.children = V_ext.size();
+            stats.duplicates = V_ext.size() - kept.size() - level_bound_pruned - level_dominated;
+            stats.bound_pruned = level_bound_pruned;
+            stats.dominated_nodes = level_dominated;
+            stats.dominated_letters = -dominated_before;
+            for (const auto& expander : expanders) stats.dominated_letters += expander.dominated_letters;
+            stats.selected = selected.size();
+            stats.expansion_ns = phase_ns[0][0];
+            stats.dedup_ns = phase_ns[0][1];
+            for (const auto& ns : phase_ns) {
+                stats.features_ns = max(stats.features_ns, ns[2]);
+                stats.inference_ns = max(stats.inference_ns, ns[3]);
+            }
+            stats.selection_ns = ns_between(selection_start, commit_start);
+            stats.commit_ns = ns_between(commit_start, clock::now());
+            level_stats->push_back(stats);
+        }
 
-        seen_nodes.clear();
+        if (memory_limit > 0) {
+            size_t retained = pool.bytes();
+            size_t working = V_ext.bytes() * (n_threads > 1 ? 2 : 1) + kept.size() * (n_features + 1) * sizeof(double);
+            size_t budget = memory_limit / 10 * 9;
+            if (retained + working > budget) {
+                // the working set came from expanding a beam of expanded_nodes nodes
+                double scale = (budget > retained) ? double(budget - retained) / working : 0.0;
+                beta = max(1, static_cast<int>(min<double>(beta, expanded_nodes * scale)));
+            }
+        }
+        result.beam_width = beta;
 
         auto duration = chrono::duration_cast<chrono::milliseconds>(
                             chrono::high_resolution_clock::now() - start_time);
-        running_time = duration.count() / 1000.0;
+        result.time = duration.count() / 1000.0;
 
-        if (running_time >= t_lim) break;
+        if (result.time >= t_lim) break;
+        if (options.node_budget > 0 && result.nodes_expanded >= options.node_budget) break;
     }
 
-    if (!training) {
-        solution = best_node->export_solution();
-        save_in_file(neural_network.output_filename, inst);
+    result.length = l_best;
+    result.solution = pool.export_solution(l_best, best_idx);
+    return result;
+}
+
+// Anytime driver: runs BS() with beam widths initial_beta, 2 * initial_beta, ...
+// until t_lim seconds are spent, each run getting the time left. Every solution
+// better than the previous ones is written to out as soon as it is found, with
+// the time since the start. A run whose beam never filled up would only repeat
+// itself with a wider beam, and one that had to narrow it to stay within the
+// memory limit cannot widen further, so either ends the widening.
+BSResult anytime_BS(double t_lim, int initial_beta, Instance* inst, MLP& neural_network,
+                    const BSOptions& options, std::ostream& out) {
+    BSResult best;
+    bool reported = false;
+    auto start_time = chrono::steady_clock::now();
+    auto elapsed = [&start_time]() {
+        return chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    };
+
+    for (int beta = max(initial_beta, 1); elapsed() < t_lim; beta *= 2) {
+        BSOptions run_options = options;
+        run_options.incumbent = max(options.incumbent, best.length); // prunes with the upper bound, if on
+        BSResult result = BS(t_lim - elapsed(), beta, inst, neural_network, run_options);
+        result.time = elapsed();
+
+        if (!reported || result.length > best.length) {
+            best = result;
+            write_result(out, inst, best);
+            reported = true;
+        }
+
+        if (result.max_beam_size < beta || result.beam_width < beta || beta > INT_MAX / 2)
+            break;
     }
 
-    for (Node* node : to_delete) delete node;
-    return l_best;
+    if (!reported)
+        write_result(out, inst, best);
+    return best;
+}
+
+// Peak resident set size of the process so far, in MB
+double peak_memory_mb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0; // ru_maxrss is in KB on Linux
+}
+
+void write_level_stats(const std::string& path, const std::vector<LevelStats>& level_stats) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Error opening the file." << std::endl;
+        return;
+    }
+    out << "level,beam_size,children,duplicates,dominated_letters,bound_pruned,dominated_nodes,selected,"
+           "expansion_ns,dedup_ns,features_ns,inference_ns,selection_ns,commit_ns\n";
+    out << fixed << setprecision(0);
+    for (const auto& s : level_stats)
+        out << s.level << "," << s.beam_size << "," << s.children << "," << s.duplicates << ","
+            << s.dominated_letters << "," << s.bound_pruned << "," << s.dominated_nodes << "," << s.selected << "," << s.expansion_ns << "," << s.dedup_ns << ","
+            << s.features_ns << "," << s.inference_ns << "," << s.selection_ns << "," << s.commit_ns << "\n";
 }
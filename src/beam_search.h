@@ -2,9 +2,62 @@
 
 #include <vector>
 #include <string>
+#include <ostream>
+#include <cstddef>
 
 class Instance;
 class MLP;
+class NodeLevel;
 
-double BS(double time_limit, int beam_width, Instance* inst, MLP& neural_network, bool training);
+struct BSResult {
+    int length = 0;                // length of the best solution found
+    std::vector<int> solution;     // best solution, as letters of the instance alphabet
+    double time = 0.0;             // running time in seconds
+    int levels = 0;                // number of levels expanded
+    long long nodes_expanded = 0;  // number of beam nodes expanded
+    int max_beam_size = 0;         // size of the largest level kept
+    int beam_width = 0;            // beam width at the end, lower than requested if the memory limit was hit
+    long long bound_pruned = 0;    // children dropped by the upper bound
+    long long dominated_nodes = 0; // children dropped by the cross-parent dominance filter
+};
+
+// Counters and phase times of one beam search level (see BS())
+struct LevelStats {
+    int level = 0;
+    long long beam_size = 0;          // nodes expanded
+    long long children = 0;           // extension set size
+    long long duplicates = 0;         // children dropped by duplicate detection
+    long long dominated_letters = 0;  // feasible letters pruned by domination
+    long long bound_pruned = 0;       // children dropped by the upper bound
+    long long dominated_nodes = 0;    // children dropped by the cross-parent dominance filter
+    long long selected = 0;           // nodes kept for the next level
+    double expansion_ns = 0.0, dedup_ns = 0.0, features_ns = 0.0, inference_ns = 0.0; // dedup_ns includes the bound and dominance checks
+    double selection_ns = 0.0, commit_ns = 0.0;
+};
+
+int features_per_node(int feature_config);
+void compute_features(const NodeLevel& V_ext, const std::vector<int>& kept, size_t begin, size_t end,
+                      int l_v, Instance* inst, int feature_config, std::vector<double>& features);
+void select_best(const std::vector<double>& heuristic_values, int beta, std::vector<int>& selected);
+// Optional behaviour of BS(), off by default
+struct BSOptions {
+    int n_threads = 1;                              // threads expanding each level
+    size_t memory_limit = 0;                        // bytes, 0 = none
+    int upper_bound = 0;                            // UpperBound level used for pruning, 0 = none
+    int incumbent = 0;                              // length of a known solution, to prune against
+    int dominance_references = 0;                   // reference nodes of the DominanceFilter, 0 = none
+    long long node_budget = 0;                      // beam nodes to expand at most, 0 = none
+    std::vector<LevelStats>* level_stats = nullptr; // per-level records, when profiling
+};
+
+BSResult BS(double time_limit, int beam_width, Instance* inst, MLP& neural_network, const BSOptions& options = {});
+BSResult anytime_BS(double time_limit, int initial_beam_width, Instance* inst, MLP& neural_network,
+                    const BSOptions& options, std::ostream& out);
+double peak_memory_mb();
+void write_level_stats(const std::string& path, const std::vector<LevelStats>& level_stats);
+
+bool validate_solution(Instance* inst, const std::vector<int>& solution);
+void write_result(std::ostream& out, Instance* inst, const BSResult& result);
+void write_error(std::ostream& out, const std::string& file_name, const std::string& message); // record of an unsolved instance
+void save_in_file(const std::string& outfile, Instance* inst, const BSResult& result);
 
@@ -0,0 +1,519 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <cstdio>
+#include <vector>
+#include <set>
+#include <tuple>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <filesystem>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "beam_search.h"
+#include "node.h"
+#include "nnet.h"
+#include "instance.h"
+
+// Microbenchmarks of the beam search building blocks. Output is one CSV record
+// per measurement so results can be compared between versions.
+
+using namespace std;
+
+double elapsed_ns(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+// Walks the first max_levels levels of a beam search on inst. Each level l is
+// expanded (taking expansion_ns) into expander.children, then visit(l, parents,
+// expander, kept, expansion_ns) gets the level's nodes as parents and kept = every
+// child, and may filter or reorder kept; the first beta entries left in kept are
+// committed as the next level.
+// Returns the number of levels walked.
+template <typename Visit>
+int walk_levels(Instance* inst, int beta, int max_levels, Visit visit) {
+    NodePool pool(inst);
+    NodeExpander expander(pool);
+    vector<int> kept;
+    int l = 0;
+
+    for (; l < max_levels && !pool.levels[l].empty(); ++l) {
+        expander.children.clear();
+        auto start = chrono::steady_clock::now();
+        for (size_t idx = 0; idx < pool.levels[l].size(); ++idx)
+            expander.expansion(l, idx);
+        double expansion_ns = elapsed_ns(start);
+
+        kept.resize(expander.children.size());
+        iota(kept.begin(), kept.end(), 0);
+        visit(l, pool.levels[l], expander, kept, expansion_ns);
+
+        if (kept.size() > static_cast<size_t>(beta))
+            kept.resize(beta);
+        pool.commit(expander.children, kept);
+    }
+    return l;
+}
+
+// Per-level cost of duplicate detection over the extension set, comparing the
+// hash set used by BS() with the std::set of (S, R) vector tuples it replaced.
+void bench_dedup(Instance* inst, int beta, int max_levels) {
+    NodeHashSet seen_nodes(inst->m, inst->p);
+    const int m = inst->m, p = inst->p, stride = m + p + inst->r;
+
+    double set_ns = 0.0, hash_ns = 0.0;
+    size_t candidates = 0;
+
+    auto visit = [&](int l, const NodeLevel&, NodeExpander& expander, vector<int>& kept, double) {
+        const NodeLevel& V_ext = expander.children;
+        candidates += V_ext.size();
+
+        auto start = chrono::steady_clock::now();
+        set<tuple<vector<int>, vector<int>>> seen_tuples;
+        size_t unique_tuples = 0;
+        for (size_t idx = 0; idx < V_ext.size(); ++idx) {
+            const int* pos = V_ext.position(idx);
+            auto key = make_tuple(vector<int>(pos, pos + m), vector<int>(pos + m + p, pos + stride));
+            unique_tuples += seen_tuples.insert(key).second;
+        }
+        set_ns += elapsed_ns(start);
+
+        start = chrono::steady_clock::now();
+        kept.clear();
+        seen_nodes.reset();
+        for (size_t idx = 0; idx < V_ext.size(); ++idx)
+            if (seen_nodes.insert(V_ext, idx))
+                kept.push_back(idx);
+        hash_ns += elapsed_ns(start);
+
+        if (kept.size() != unique_tuples) {
+            cerr << "Error: dedup mismatch at level " << l << ".\n";
+            exit(EXIT_FAILURE);
+        }
+    };
+    int levels = walk_levels(inst, beta, max_levels, visit);
+
+    cout << "dedup," << beta << "," << levels << "," << candidates / max(levels, 1) << ","
+         << set_ns / max(levels, 1) << "," << hash_ns / max(levels, 1) << endl;
+}
+
+// Per-level cost and removed nodes of the cross-parent DominanceFilter with
+// n_references reference nodes, run after dedup as in BS()
+void bench_dominance(Instance* inst, int beta, int max_levels, int n_references) {
+    NodeHashSet seen_nodes(inst->m, inst->p);
+    DominanceFilter dominance(inst->m, inst->p, inst->m + inst->p + inst->r, n_references);
+
+    double filter_ns = 0.0;
+    size_t candidates = 0, removed = 0;
+    vector<char> keep;
+
+    auto visit = [&](int, const NodeLevel&, NodeExpander& expander, vector<int>& kept, double) {
+        const NodeLevel& V_ext = expander.children;
+        kept.clear();
+        seen_nodes.reset();
+        for (size_t idx = 0; idx < V_ext.size(); ++idx)
+            if (seen_nodes.insert(V_ext, idx))
+                kept.push_back(idx);
+        candidates += kept.size();
+
+        auto start = chrono::steady_clock::now();
+        keep.assign(V_ext.size(), 1);
+        dominance.select_references(V_ext, kept, keep);
+        for (size_t i = 0; i < dominance.n_pending(); ++i)
+            if (dominance.dominated(V_ext, dominance.pending(i)))
+                keep[dominance.pending(i)] = 0;
+        filter_ns += elapsed_ns(start);
+
+        size_t undominated = kept.size();
+        erase_if(kept, [&keep](int idx) { return !keep[idx]; });
+        removed += undominated - kept.size();
+    };
+    int levels = walk_levels(inst, beta, max_levels, visit);
+
+    cout << "dominance," << beta << "," << n_references << "," << levels << "," << candidates / max(levels, 1) << ","
+         << removed / max(levels, 1) << "," << filter_ns / max(levels, 1) << endl;
+}
+
+// Network with seeded random weights, as a stand-in for trained weights
+MLP random_network(int activation_function, const vector<size_t>& units_per_layer) {
+    mt19937 rng(12345);
+    normal_distribution<double> dist(0.0, 1.0);
+
+    MLP neural_network;
+    neural_network.activation_function = activation_function;
+    neural_network.units_per_layer = units_per_layer;
+
+    vector<double> weights;
+    for (size_t i = 0; i + 1 < units_per_layer.size(); ++i)
+        for (size_t w = 0; w < (units_per_layer[i] + 1) * units_per_layer[i + 1]; ++w)
+            weights.push_back(dist(rng));
+    neural_network.store_weights(weights);
+    return neural_network;
+}
+
+// Cost per evaluated node of MLP::forward() against MLP::forward_batch() on a
+// batch of n random feature vectors, once through the dynamic per-layer products
+// and once through the compiled FixedMLP kernel (when the shape has one), plus
+// the largest difference of either batched path from forward().
+void bench_mlp(int activation_function, const vector<size_t>& units_per_layer, int n) {
+    MLP neural_network = random_network(activation_function, units_per_layer);
+
+    mt19937 rng(54321);
+    normal_distribution<double> dist(0.0, 1.0);
+    Eigen::MatrixXd X(units_per_layer[0], n);
+    for (Eigen::Index c = 0; c < X.cols(); ++c)
+        for (Eigen::Index r = 0; r < X.rows(); ++r)
+            X(r, c) = dist(rng);
+
+    // best of a few repetitions, to filter out scheduling noise
+    const int repetitions = 5;
+
+    vector<double> single(n);
+    double forward_ns = numeric_limits<double>::max();
+    for (int rep = 0; rep < repetitions; ++rep) {
+        auto start = chrono::steady_clock::now();
+        for (int c = 0; c < n; ++c)
+            single[c] = neural_network.forward(X.col(c))(0);
+        forward_ns = min(forward_ns, elapsed_ns(start) / n);
+    }
+
+    auto time_batch = [&](double& max_diff) {
+        vector<Eigen::MatrixXd> layer_outputs;
+        neural_network.forward_batch(X, layer_outputs); // warm up the scratch buffers
+        double ns = numeric_limits<double>::max();
+        for (int rep = 0; rep < repetitions; ++rep) {
+            auto start = chrono::steady_clock::now();
+            neural_network.forward_batch(X, layer_outputs);
+            ns = min(ns, elapsed_ns(start) / n);
+        }
+        const Eigen::MatrixXd& batch = layer_outputs.back();
+        for (int c = 0; c < n; ++c)
+            max_diff = max(max_diff, abs(single[c] - batch(0, c)));
+        return ns;
+    };
+
+    double max_diff = 0.0;
+    double fixed_ns = neural_network.fixed_network ? time_batch(max_diff) : 0.0;
+    neural_network.fixed_network.reset();
+    double dynamic_ns = time_batch(max_diff);
+
+    cout << "mlp," << activation_function << "," << units_per_layer.size() - 2 << "," << n << ","
+         << forward_ns << "," << dynamic_ns << "," << fixed_ns << "," << scientific << max_diff << fixed << endl;
+}
+
+// Per-level cost of picking the beta best of an extension set of
+// children_per_node * beta nodes: full sort (as BS() used to) against select_best().
+// Heuristic values are rounded to 1e-3 so that ties occur as with saturated networks.
+void bench_selection(int beta, int children_per_node) {
+    mt19937 rng(beta);
+    uniform_real_distribution<double> dist(-1.0, 1.0);
+    vector<double> heuristic_values(static_cast<size_t>(beta) * children_per_node);
+    for (double& h : heuristic_values)
+        h = round(dist(rng) * 1000.0) / 1000.0;
+
+    const int repetitions = 5;
+    double sort_ns = numeric_limits<double>::max(), select_ns = numeric_limits<double>::max();
+    vector<int> sorted, selected;
+
+    for (int rep = 0; rep < repetitions; ++rep) {
+        auto start = chrono::steady_clock::now();
+        sorted.resize(heuristic_values.size());
+        iota(sorted.begin(), sorted.end(), 0);
+        sort(sorted.begin(), sorted.end(), [&heuristic_values](int a, int b) {
+            return heuristic_values[a] != heuristic_values[b] ? heuristic_values[a] > heuristic_values[b] : a < b;
+        });
+        sorted.resize(beta);
+        sort_ns = min(sort_ns, elapsed_ns(start));
+
+        start = chrono::steady_clock::now();
+        select_best(heuristic_values, beta, selected);
+        select_ns = min(select_ns, elapsed_ns(start));
+    }
+
+    if (selected != sorted) {
+        cerr << "Error: selection mismatch at beam width " << beta << ".\n";
+        exit(EXIT_FAILURE);
+    }
+
+    cout << "selection," << beta << "," << heuristic_values.size() << "," << sort_ns << "," << select_ns << endl;
+}
+
+// Memory held by the preprocessed tables of inst, against the nested
+// vector<vector<vector<int>>> layout ([char][string][pos]) they replaced.
+void bench_instance_tables(const Instance& inst) {
+    const size_t header = sizeof(vector<int>);
+    size_t s_length = 0, p_length = 0;
+    for (const auto& s : inst.S) s_length += s.size();
+    for (const auto& pj : inst.P) p_length += pj.size();
+
+    size_t nested_bytes = 2 * (header + inst.Sigma * (header + inst.m * header) + inst.Sigma * s_length * sizeof(int)) +
+                          header + inst.m * (header + inst.p * header) + inst.m * p_length * sizeof(int);
+
+    cout << "instance_tables," << inst.m << "," << inst.Sigma << "," << s_length << ","
+         << nested_bytes << "," << inst.table_bytes() << endl;
+}
+
+// Time to load the instance at path from its text file and from a binary copy
+// written by Instance::save_binary(), averaged over repeats loads.
+void bench_instance_load(const string& path, int repeats) {
+    const string binary_path = "bench_instance.bin";
+    Instance(path).save_binary(binary_path);
+
+    double text_ns = 0.0, binary_ns = 0.0;
+    size_t checksum = 0;
+    for (int k = 0; k < repeats; ++k) {
+        auto start = chrono::steady_clock::now();
+        Instance text(path);
+        text_ns += elapsed_ns(start);
+
+        start = chrono::steady_clock::now();
+        Instance binary(binary_path);
+        binary_ns += elapsed_ns(start);
+        checksum += text.table_bytes() + binary.table_bytes();
+    }
+    remove(binary_path.c_str());
+
+    cout << "instance_load," << checksum / (2 * repeats) << "," << text_ns / repeats / 1000 << ","
+         << binary_ns / repeats / 1000 << endl;
+}
+
+// Cost per expanded node of NodeExpander::sigma_feasible_letters() alone and of the
+// whole NodeExpander::expansion() over the first levels of a beam search that
+// keeps the first beta children of each level.
+void bench_expansion(Instance* inst, int beta, int max_levels) {
+    double feasible_ns = 0.0, ns = 0.0;
+    size_t expanded = 0;
+
+    auto visit = [&](int, const NodeLevel& parents, NodeExpander& expander, vector<int>&, double expansion_ns) {
+        auto start = chrono::steady_clock::now();
+        for (size_t idx = 0; idx < parents.size(); ++idx)
+            expander.sigma_feasible_letters(parents.position(idx));
+        feasible_ns += elapsed_ns(start);
+        ns += expansion_ns;
+        expanded += parents.size();
+    };
+    walk_levels(inst, beta, max_levels, visit);
+
+    cout << "expansion," << beta << "," << expanded << "," << feasible_ns / max<size_t>(expanded, 1) << ","
+         << ns / max<size_t>(expanded, 1) << endl;
+}
+
+// Feature computation as BS() did it before it was fused: per-node vectors of
+// normalized positions, one pass per statistic, then standardize().
+void reference_features(const NodeLevel& level, size_t idx, int l_v, Instance* inst,
+                        int feature_config, vector<double>& node_features) {
+    // statistics of an empty vector are 0, as in summarize()
+    auto maximum = [](const vector<double>& v) { return v.empty() ? 0.0 : *max_element(v.begin(), v.end()); };
+    auto minimum = [](const vector<double>& v) { return v.empty() ? 0.0 : *min_element(v.begin(), v.end()); };
+    auto average = [](const vector<double>& v) { return v.empty() ? 0.0 : accumulate(v.begin(), v.end(), 0.0) / v.size(); };
+    auto std_dev = [](const vector<double>& v, double mean) {
+        if (v.empty()) return 0.0;
+        double sum_sq = 0.0;
+        for (double x : v) sum_sq += (x - mean) * (x - mean);
+        return sqrt(sum_sq / v.size());
+    };
+
+    const int* position = level.position(idx);
+    vector<double> pL_v(position, position + inst->m);
+    vector<double> lv(position + inst->m + inst->p, position + inst->m + inst->p + inst->r);
+    for (size_t i = 0; i < pL_v.size(); ++i) pL_v[i] /= inst->S[i].size();
+    for (size_t i = 0; i < lv.size(); ++i) lv[i] /= inst->R[i].size();
+
+    node_features = {
+        maximum(pL_v), minimum(pL_v),
+        average(pL_v), std_dev(pL_v, average(pL_v)),
+        maximum(lv), minimum(lv),
+        average(lv), std_dev(lv, average(lv)),
+        static_cast<double>(l_v)
+    };
+    if (feature_config >= 2) node_features.push_back(inst->Sigma);
+    if (feature_config >= 3) {
+        node_features.push_back(inst->m);
+        node_features.push_back(inst->r);
+    }
+    if (feature_config == 4) {
+        node_features.push_back(inst->S[0].size());
+        node_features.push_back(inst->r > 0 ? inst->R[0].size() : 0);
+    }
+
+    double avg = average(node_features), sd = std_dev(node_features, avg);
+    for (double& f : node_features) f = (f - avg) / sd;
+}
+
+// Cost per node of compute_features() against the reference implementation over
+// the extension sets of the first levels of a beam search keeping the first beta
+// children, plus the largest difference between the two (expected to be 0).
+void bench_features(Instance* inst, int beta, int max_levels, int feature_config) {
+    const int n_features = features_per_node(feature_config);
+    vector<double> features, node_features;
+    double reference_ns = 0.0, fused_ns = 0.0, max_difference = 0.0;
+    volatile double sink = 0.0; // keeps the timed reference calls alive
+    size_t nodes = 0;
+
+    auto visit = [&](int l, const NodeLevel&, NodeExpander& expander, vector<int>& kept, double) {
+        const NodeLevel& children = expander.children;
+        features.resize(children.size() * n_features);
+
+        auto start = chrono::steady_clock::now();
+        for (size_t idx = 0; idx < children.size(); ++idx) {
+            reference_features(children, idx, l + 1, inst, feature_config, node_features);
+            sink = node_features.back();
+        }
+        reference_ns += elapsed_ns(start);
+
+        start = chrono::steady_clock::now();
+        compute_features(children, kept, 0, children.size(), l + 1, inst, feature_config, features);
+        fused_ns += elapsed_ns(start);
+        nodes += children.size();
+
+        for (size_t idx = 0; idx < children.size(); ++idx) {
+            reference_features(children, idx, l + 1, inst, feature_config, node_features);
+            for (int c = 0; c < n_features; ++c)
+                max_difference = max(max_difference, abs(node_features[c] - features[idx * n_features + c]));
+        }
+    };
+    walk_levels(inst, beta, max_levels, visit);
+
+    cout << "features," << feature_config << "," << nodes << "," << reference_ns / max<size_t>(nodes, 1) << ","
+         << fused_ns / max<size_t>(nodes, 1) << "," << scientific << max_difference << fixed << endl;
+}
+
+// Whole-solver throughput of BS() over every instance of a set at beam width beta
+// (instance loading excluded). The run is done in a forked child so that the peak
+// memory, read from the child's rusage by wait4(), is that of this run alone.
+void bench_macro(const string& set, const vector<string>& files, int beta, MLP& neural_network) {
+    cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+        cerr << "Error: could not fork the macro benchmark.\n";
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0) {
+        long long nodes = 0, levels = 0;
+        double seconds = 0.0;
+        for (const string& file : files) {
+            Instance inst(file);
+            auto start = chrono::steady_clock::now();
+            BSResult result = BS(numeric_limits<double>::max(), beta, &inst, neural_network);
+            seconds += elapsed_ns(start) / 1e9;
+            nodes += result.nodes_expanded;
+            levels += result.levels;
+        }
+        // the child writes the record up to the memory column, the parent completes it
+        cout << "macro," << set << "," << beta << "," << files.size() << "," << levels << "," << nodes << ","
+             << seconds << "," << nodes / seconds << "," << levels / seconds << "," << flush;
+        _exit(EXIT_SUCCESS);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        cerr << "Error: macro benchmark of " << set << " at beam width " << beta << " failed.\n";
+        exit(EXIT_FAILURE);
+    }
+    cout << usage.ru_maxrss / 1024.0 << endl; // ru_maxrss is in KB on Linux
+}
+
+// ./bench -macro <instances directory> [-weights <file>] [beam widths]: runs
+// bench_macro() on the poz_12_10_* and neg_12_10_* sets of the directory. The
+// network is 9-10-5-1 with tanh and feature configuration 1, with seeded random
+// weights unless trained ones are given. Random weights end the searches early,
+// so trained weights give a more representative workload.
+int run_macro(const string& directory, const string& weights_file, vector<int> beam_widths) {
+    if (beam_widths.empty()) beam_widths = {10, 100};
+    MLP neural_network = random_network(1, {9, 10, 5, 1});
+    if (!weights_file.empty()) {
+        ifstream weights_in(weights_file);
+        vector<double> weights;
+        double w;
+        while (weights_in >> w) weights.push_back(w);
+        if (weights.size() != (9 + 1) * 10 + (10 + 1) * 5 + (5 + 1) * 1) {
+            cerr << "Error: " << weights_file << " does not hold the weights of a 9-10-5-1 network.\n";
+            return EXIT_FAILURE;
+        }
+        neural_network.store_weights(weights);
+    }
+
+    cout << "benchmark,set,beam_width,instances,levels,expanded_nodes,seconds,"
+            "nodes_per_s,levels_per_s,peak_memory_mb" << endl;
+    for (const string set : {"poz_12_10", "neg_12_10"}) {
+        vector<string> files;
+        for (const auto& entry : filesystem::directory_iterator(directory))
+            if (entry.path().filename().string().rfind(set + "_", 0) == 0)
+                files.push_back(entry.path().string());
+        sort(files.begin(), files.end());
+        if (files.empty()) {
+            cerr << "No " << set << "_* instances in " << directory << "\n";
+            continue;
+        }
+        for (int beta : beam_widths)
+            bench_macro(set, files, beta, neural_network);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || (string(argv[1]) == "-macro" && argc < 3)) {
+        cerr << "Usage: " << argv[0] << " <instance> [levels]\n"
+             << "       " << argv[0] << " -macro <instances directory> [-weights <file>] [beam widths]\n";
+        return EXIT_FAILURE;
+    }
+    if (string(argv[1]) == "-macro") {
+        string weights_file;
+        vector<int> beam_widths;
+        for (int i = 3; i < argc; ++i) {
+            if (string(argv[i]) == "-weights" && i + 1 < argc) weights_file = argv[++i];
+            else beam_widths.push_back(stoi(argv[i]));
+        }
+        return run_macro(argv[2], weights_file, beam_widths);
+    }
+    int max_levels = (argc > 2) ? stoi(argv[2]) : 50;
+
+    Instance inst(argv[1]);
+    cout << fixed << setprecision(1);
+
+    cout << "benchmark,m,Sigma,total_s_length,nested_table_bytes,table_bytes" << endl;
+    bench_instance_tables(inst);
+
+    cout << "benchmark,table_bytes,text_us_per_load,binary_us_per_load" << endl;
+    bench_instance_load(argv[1], 20);
+
+    cout << "benchmark,beam_width,expanded_nodes,feasible_letters_ns_per_node,ns_per_expansion" << endl;
+    for (int beta : {100, 1000})
+        bench_expansion(&inst, beta, max_levels);
+
+    cout << "benchmark,feature_configuration,nodes,reference_ns_per_node,fused_ns_per_node,max_abs_difference" << endl;
+    for (int feature_config : {1, 2, 3, 4})
+        bench_features(&inst, 100, max_levels, feature_config);
+
+    cout << "benchmark,beam_width,levels,candidates_per_level,set_ns_per_level,hash_ns_per_level" << endl;
+    for (int beta : {100, 1000, 10000})
+        bench_dedup(&inst, beta, max_levels);
+
+    cout << "benchmark,beam_width,references,levels,candidates_per_level,removed_per_level,filter_ns_per_level" << endl;
+    for (int beta : {100, 1000, 10000})
+        for (int n_references : {8, 32})
+            bench_dominance(&inst, beta, max_levels, n_references);
+
+    cout << "benchmark,beam_width,candidates_per_level,sort_ns_per_level,select_ns_per_level" << endl;
+    for (int beta : {100, 1000, 10000})
+        bench_selection(beta, 17);
+
+    cout << "benchmark,activation_function,hidden_layers,nodes,forward_ns_per_node,"
+            "batch_dynamic_ns_per_node,batch_fixed_ns_per_node,max_abs_difference" << endl;
+    for (int activation_function : {1, 2, 3}) {
+        for (int n : {100, 10000}) {
+            bench_mlp(activation_function, {9, 10, 5, 1}, n);
+            bench_mlp(activation_function, {12, 10, 10, 10, 1}, n);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <climits>
+#include "bounds.h"
+#include "instance.h"
+
+UpperBound::UpperBound(const Instance* inst, int level)
+    : inst(inst), level(level), min_occurrences(inst->Sigma) {}
+
+int UpperBound::operator()(const int* position) const {
+    const int m = inst->m, Sigma = inst->Sigma;
+
+    // every appended letter must still occur in each S string
+    std::fill(min_occurrences.begin(), min_occurrences.end(), INT_MAX);
+    for (int i = 0; i < m; ++i) {
+        size_t row = (inst->s_offsets[i] + position[i]) * Sigma;
+        for (int a = 0; a < Sigma; ++a)
+            min_occurrences[a] = std::min(min_occurrences[a], inst->occurances_string_pos_char[row + a]);
+    }
+    int bound = 0;
+    for (int a = 0; a < Sigma; ++a)
+        bound += min_occurrences[a];
+
+    // and the appended letters form a common subsequence of each pair of S suffixes
+    if (level >= 2 && !inst->lcs_offsets.empty()) {
+        for (int i = 0; i + 1 < m && bound > 0; ++i) {
+            size_t columns = inst->S[i + 1].size() + 1;
+            bound = std::min(bound, inst->suffix_lcs[inst->lcs_offsets[i] + position[i] * columns + position[i + 1]]);
+        }
+    }
+    return bound;
+}
+
+static int lcs_length(const std::vector<int>& a, const std::vector<int>& b) {
+    std::vector<int> row(b.size() + 1, 0);
+    for (int x : a) {
+        int diagonal = 0; // row[y] of the previous character of a
+        for (size_t y = 0; y < b.size(); ++y) {
+            int above = row[y + 1];
+            row[y + 1] = (x == b[y]) ? diagonal + 1 : std::max(above, row[y]);
+            diagonal = above;
+        }
+    }
+    return row.back();
+}
+
+int root_upper_bound(const Instance* inst) {
+    std::vector<int> root(inst->m + inst->p + inst->r, 0);
+    int bound = UpperBound(inst, 1)(root.data());
+    for (int i = 0; i < inst->m; ++i)
+        for (int j = i + 1; j < inst->m; ++j)
+            bound = std::min(bound, lcs_length(inst->S[i], inst->S[j]));
+    return bound;
+}
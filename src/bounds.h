@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+
+class Instance;
+
+// Upper bounds on the number of letters that can still be appended to a node,
+// computed from its position row (S positions first):
+//  level 1: sum over letters of the fewest occurrences left in any S string
+//  level 2: also the suffix LCS of consecutive S string pairs (needs
+//           Instance::build_suffix_lcs(), skipped otherwise)
+// Each thread uses its own UpperBound, as for NodeExpander.
+class UpperBound {
+public:
+    UpperBound(const Instance* inst, int level);
+
+    int operator()(const int* position) const;
+
+private:
+    const Instance* inst;
+    int level;
+    mutable std::vector<int> min_occurrences; // scratch, per letter
+};
+
+// Upper bound on the solution length of inst: the smaller of the level 1 bound at
+// the root and the LCS of every pair of S strings. The LCS are computed with one
+// row of memory each, so no tables are built.
+int root_upper_bound(const Instance* inst);
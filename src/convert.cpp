@@ -0,0 +1,24 @@
+#include <iostream>
+#include <string>
+#include <stdexcept>
+#include "instance.h"
+
+// Converts text instance files to the binary format read by Instance::load_binary():
+// ./convert <instance> <binary output> [<instance> <binary output> ...]
+int main(int argc, char** argv) {
+    if (argc < 3 || argc % 2 == 0) {
+        std::cerr << "Usage: " << argv[0] << " <instance> <binary output> [<instance> <binary output> ...]\n";
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        try {
+            Instance inst(argv[i]);
+            inst.save_binary(argv[i + 1]);
+        } catch (const std::runtime_error& error) {
+            std::cerr << error.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    return 0;
+}
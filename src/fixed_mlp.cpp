@@ -0,0 +1,126 @@
+#include <vector>
+#include <algorithm>
+#include "fixed_mlp.h"
+#include "nnet.h"
+
+namespace {
+
+template <int Activation, typename Vector>
+inline void activate(Vector& x) {
+    if constexpr (Activation == 1) {
+        x = x.array().tanh().matrix();
+    } else if constexpr (Activation == 2) {
+        x = x.array().max(0).matrix();
+    } else if constexpr (Activation == 3) {
+        x = (1.0 / (1.0 + (-x.array()).exp())).matrix();
+    }
+}
+
+// Nodes evaluated together; wider blocks spill the unrolled products out of registers.
+constexpr int block_columns = 4;
+
+// row-major, so that one unit's values over the block's nodes are contiguous
+template <int Rows>
+using Block = Eigen::Matrix<double, Rows, block_columns, Eigen::RowMajor>;
+
+// Chain of layers In -> Out -> Rest..., terminated by the single output unit
+template <int Activation, int In, int... Out>
+struct Layers {
+    static_assert(In == 1, "the last layer must have a single output unit");
+
+    void load(const MLP&, size_t) {}
+};
+
+template <int Activation, int In, int Out, int... Rest>
+struct Layers<Activation, In, Out, Rest...> {
+    Eigen::Matrix<double, Out, In> W;
+    Eigen::Matrix<double, Out, 1> b;
+    Layers<Activation, Out, Rest...> next;
+
+    void load(const MLP& neural_network, size_t layer) {
+        W = neural_network.weight_matrices[layer];
+        b = neural_network.bias_vectors[layer];
+        next.load(neural_network, layer + 1);
+    }
+
+    template <typename Output>
+    void output(const Block<In>& x, Output& out) const {
+        // y = W * x + b as unrolled axpys over the block's nodes
+        Block<Out> y;
+        for (int o = 0; o < Out; ++o) {
+            y.row(o).setConstant(b(o));
+            for (int k = 0; k < In; ++k)
+                y.row(o) += W(o, k) * x.row(k);
+        }
+        activate<Activation>(y);
+        if constexpr (sizeof...(Rest) == 0)
+            out = y;
+        else
+            next.output(y, out);
+    }
+};
+
+template <int Activation, int Inputs, int... Units>
+class FixedShapeMLP : public FixedMLP {
+    Layers<Activation, Inputs, Units...> layers;
+
+public:
+    explicit FixedShapeMLP(const MLP& neural_network) { layers.load(neural_network, 0); }
+
+    void forward_batch(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out) const override {
+        const Eigen::Index n = X.cols();
+        Block<Inputs> x;
+        Block<1> y;
+
+        Eigen::Index c = 0;
+        for (; c + block_columns <= n; c += block_columns) {
+            x = X.middleCols<block_columns>(c);
+            layers.output(x, y);
+            Eigen::Map<Block<1>>(out + c) = y;
+        }
+
+        // last partial block, padded with zero columns
+        if (c < n) {
+            x.setZero();
+            x.leftCols(n - c) = X.middleCols(c, n - c);
+            layers.output(x, y);
+            std::copy_n(y.data(), n - c, out + c);
+        }
+    }
+};
+
+template <int Activation, int... Units>
+std::shared_ptr<const FixedMLP> make_shape(const MLP& neural_network) {
+    return std::make_shared<FixedShapeMLP<Activation, Units...>>(neural_network);
+}
+
+struct FixedShape {
+    std::vector<size_t> units_per_layer;
+    int activation_function;
+    std::shared_ptr<const FixedMLP> (*make)(const MLP&);
+};
+
+#define FIXED_SHAPE(...)                                   \
+    {{__VA_ARGS__}, 1, &make_shape<1, __VA_ARGS__>},       \
+    {{__VA_ARGS__}, 2, &make_shape<2, __VA_ARGS__>},       \
+    {{__VA_ARGS__}, 3, &make_shape<3, __VA_ARGS__>}
+
+// hidden layouts instantiated for each of the 9, 10, 12 and 14 feature configurations
+#define FIXED_SHAPES(inputs)                                                         \
+    FIXED_SHAPE(inputs, 5, 1), FIXED_SHAPE(inputs, 10, 1), FIXED_SHAPE(inputs, 5, 5, 1), \
+    FIXED_SHAPE(inputs, 10, 5, 1), FIXED_SHAPE(inputs, 10, 10, 1), FIXED_SHAPE(inputs, 10, 10, 10, 1)
+
+const std::vector<FixedShape> fixed_shapes = {
+    FIXED_SHAPES(9), FIXED_SHAPES(10), FIXED_SHAPES(12), FIXED_SHAPES(14)
+};
+
+} // namespace
+
+std::shared_ptr<const FixedMLP> make_fixed_mlp(const MLP& neural_network) {
+    for (const auto& shape : fixed_shapes) {
+        if (shape.activation_function == neural_network.activation_function &&
+            shape.units_per_layer == neural_network.units_per_layer)
+            return shape.make(neural_network);
+    }
+    return nullptr;
+}
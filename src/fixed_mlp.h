@@ -0,0 +1,21 @@
+#pragma once
+
+#include <memory>
+#include <Eigen/Dense>
+
+class MLP;
+
+// Inference kernel for a network whose architecture is known at compile time.
+// Weights are copied into fixed-size Eigen matrices, so every layer product is
+// fully unrolled and the activations stay in registers.
+class FixedMLP {
+public:
+    virtual ~FixedMLP() = default;
+
+    // out[c] = network output for column c of X
+    virtual void forward_batch(const Eigen::Ref<const Eigen::MatrixXd>& X, double* out) const = 0;
+};
+
+// Returns a kernel specialized for the units_per_layer, activation_function and
+// current weights of neural_network, or nullptr if that shape is not instantiated.
+std::shared_ptr<const FixedMLP> make_fixed_mlp(const MLP& neural_network);
@@ -1,160 +1,462 @@
 #include "instance.h"
 #include <fstream>
-#include <sstream>
 #include <iostream>
-#include <cassert>
-#include <algorithm> 
-#include <iterator>  
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 Instance::Instance(const std::string& path)
 {
     file_name = path;
 
+    if (is_binary_file(path)) {
+        load_binary(path);
+        return;
+    }
+
     std::ifstream inputFile(path);
     if (!inputFile.is_open()) {
-        std::cerr << "Error opening the file: " << path << std::endl;
-        exit(EXIT_FAILURE);
+        throw std::runtime_error("Error opening the file: " + path);
     }
+    read(inputFile);
+}
 
-    std::string line;
-    bool first_line = true;
-    std::vector<std::string> strings;
-    int num_map = 0;
-
-    while (std::getline(inputFile, line)) {
-        std::istringstream ss(line);
-
-        if (first_line) {
-            int m, sigma, p, r;
-            if (ss >> m >> sigma >> p >> r) {
-                this->m = m;
-                this->Sigma = sigma;
-                this->p = p;
-                this->r = r;
-            } else {
-                std::cerr << "Error parsing first line: " << line << " of file " << path << std::endl;
-                exit(EXIT_FAILURE);
-            }
-            first_line = false;
-        } else {
-            int length;
-            std::string si;
-            if (ss >> length >> si) {
-                for (char c : si) {
-                    if (map_char_to_int.find(c) == map_char_to_int.end()) {
-                        map_char_to_int[c] = num_map++;
-                    }
-                }
-                strings.push_back(si);
-            } else {
-                std::cerr << "Error parsing line: " << line << " of file " << path << std::endl;
-                exit(EXIT_FAILURE);
-            }
+Instance::Instance(std::istream& in, const std::string& name)
+{
+    file_name = name;
+    read(in);
+}
+
+// Parses an instance in the file format (header line "m Sigma p r", then one
+// "length string" line per S, P and R string) and builds the tables
+void Instance::read(std::istream& in)
+{
+    std::string text(std::istreambuf_iterator<char>(in), {});
+    std::string_view rest(text);
+
+    auto is_space = [](char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; };
+    auto next_line = [&rest]() {
+        size_t end = std::min(rest.find('\n'), rest.size());
+        std::string_view line = rest.substr(0, end);
+        rest.remove_prefix(std::min(end + 1, rest.size()));
+        return line;
+    };
+    // reads an int from the front of line, after leading blanks
+    auto parse_int = [&is_space](std::string_view& line, int& value) {
+        while (!line.empty() && is_space(line.front())) line.remove_prefix(1);
+        auto [end, error] = std::from_chars(line.data(), line.data() + line.size(), value);
+        line.remove_prefix(end - line.data());
+        return error == std::errc();
+    };
+
+    std::string_view line = next_line();
+    std::string_view header = line;
+    if (!(parse_int(header, m) && parse_int(header, Sigma) && parse_int(header, p) && parse_int(header, r))) {
+        throw std::runtime_error("Error parsing first line: " + std::string(line) + " of file " + file_name);
+    }
+
+    std::vector<std::string_view> strings;
+    while (!rest.empty()) {
+        line = next_line();
+        std::string_view fields = line;
+        int length;
+        if (!parse_int(fields, length)) {
+            throw std::runtime_error("Error parsing line: " + std::string(line) + " of file " + file_name);
         }
+        while (!fields.empty() && is_space(fields.front())) fields.remove_prefix(1);
+        size_t end = 0;
+        while (end < fields.size() && !is_space(fields[end])) ++end;
+        if (end == 0) {
+            throw std::runtime_error("Error parsing line: " + std::string(line) + " of file " + file_name);
+        }
+        strings.push_back(fields.substr(0, end));
     }
-    inputFile.close();
 
-    auto convert_string_to_int_vector = [this](const std::string& s) {
-        std::vector<int> vec;
-        vec.reserve(s.size());
+    if ((int)strings.size() < m + p + r) {
+        throw std::runtime_error("Error: expected " + std::to_string(m + p + r) + " strings in file " + file_name);
+    }
+    set_strings(strings);
+}
+
+// Encodes the strings (S strings, then P strings, then R strings) and builds the
+// tables. Letters are numbered in order of first appearance. Shared by every
+// format that stores the strings as text.
+void Instance::set_strings(const std::vector<std::string_view>& strings)
+{
+    map_char_to_int.fill(-1);
+    int2char.clear();
+
+    auto encode = [this](std::string_view s) {
         for (char c : s) {
-            assert(c >= 0);
-            vec.push_back(map_char_to_int[c]);
+            if (map_char_to_int[(unsigned char)c] < 0) {
+                map_char_to_int[(unsigned char)c] = int2char.size();
+                int2char.push_back(c);
+            }
         }
+        // every char is mapped now: a branch-free table lookup per char
+        std::vector<int> vec(s.size());
+        const unsigned char* chars = reinterpret_cast<const unsigned char*>(s.data());
+        for (size_t k = 0; k < s.size(); ++k)
+            vec[k] = map_char_to_int[chars[k]];
         return vec;
     };
 
-    for (int i = 0; i < m; ++i) {
-        S.push_back(convert_string_to_int_vector(strings[i]));
-    }
-    for (int i = m; i < m + p; ++i) {
-        P.push_back(convert_string_to_int_vector(strings[i]));
-    }
-    for (int i = m + p; i < m + p + r; ++i) {
-        R.push_back(convert_string_to_int_vector(strings[i]));
-    }
-
-    for (const auto& [key, val] : map_char_to_int) {
-        int2char[val] = key;
-    }
+    S.clear();
+    P.clear();
+    R.clear();
+    for (int i = 0; i < m; ++i)
+        S.push_back(encode(strings[i]));
+    for (int i = m; i < m + p; ++i)
+        P.push_back(encode(strings[i]));
+    for (int i = m + p; i < m + p + r; ++i)
+        R.push_back(encode(strings[i]));
 
     fill_in_data_structures();
 }
 
 void Instance::fill_in_data_structures()
 {
-    // occurances_string_pos_char
-    occurances_string_pos_char.resize(Sigma);
-    for (int a = 0; a < Sigma; ++a) {
-        std::vector<std::vector<int>> occur_a_all_s;
-        occur_a_all_s.reserve(m);
-
-        for (int i = 0; i < m; ++i) {
-            const auto& s = S[i];
-            std::vector<int> pos_occur_a_in_si(s.size());
-            int count = 0;
-
-            for (int j = (int)s.size() - 1; j >= 0; --j) {
-                if (s[j] == a)
-                    ++count;
-                pos_occur_a_in_si[j] = count;
-            }
-            occur_a_all_s.push_back(std::move(pos_occur_a_in_si));
-        }
-        occurances_string_pos_char[a] = std::move(occur_a_all_s);
+    size_t max_length = 0;
+    s_offsets.resize(m + 1, 0);
+    for (int i = 0; i < m; ++i) {
+        s_offsets[i + 1] = s_offsets[i] + S[i].size() + 1;
+        max_length = std::max(max_length, S[i].size());
     }
+    const size_t rows = s_offsets[m];
 
-    // next_char_occurance_in_strings
-    next_char_occurance_in_strings.resize(Sigma);
-    for (int a = 0; a < Sigma; ++a) {
-        std::vector<std::vector<int>> next_occur_a_all_s;
-        next_occur_a_all_s.reserve(m);
+    // occurances_string_pos_char and next_char_occurance_in_strings
+    occurances_string_pos_char.assign(rows * Sigma, max_length <= std::numeric_limits<uint16_t>::max());
+    next_char_occurance_in_strings.assign(rows * Sigma, max_length <= std::numeric_limits<uint16_t>::max());
+    for (int i = 0; i < m; ++i) {
+        const auto& s = S[i];
+        size_t row = s_offsets[i] + s.size();
 
-        for (int i = 0; i < m; ++i) {
-            const auto& s = S[i];
-            int next_pos = (int)s.size();
-            std::vector<int> next_occur(s.size(), next_pos);
-
-            for (int j = (int)s.size() - 1; j >= 0; --j) {
-                if (s[j] == a)
-                    next_pos = j;
-                next_occur[j] = next_pos;
+        // past the end: no occurrences left
+        for (int a = 0; a < Sigma; ++a)
+            next_char_occurance_in_strings.set(row * Sigma + a, (int)s.size());
+
+        for (int j = (int)s.size() - 1; j >= 0; --j, --row) {
+            for (int a = 0; a < Sigma; ++a) {
+                occurances_string_pos_char.set((row - 1) * Sigma + a, occurances_string_pos_char[row * Sigma + a]);
+                next_char_occurance_in_strings.set((row - 1) * Sigma + a, next_char_occurance_in_strings[row * Sigma + a]);
+            }
+            if (s[j] < Sigma) {
+                occurances_string_pos_char.set((row - 1) * Sigma + s[j], occurances_string_pos_char[row * Sigma + s[j]] + 1);
+                next_char_occurance_in_strings.set((row - 1) * Sigma + s[j], j);
             }
-            next_occur_a_all_s.push_back(std::move(next_occur));
         }
-        next_char_occurance_in_strings[a] = std::move(next_occur_a_all_s);
     }
 
-    // remaining_patern_suffix_pos
-    remaining_patern_suffix_pos.resize(m);
+    // remaining_letters_mask
+    mask_words = (Sigma + 63) / 64;
+    remaining_letters_mask.assign(rows * mask_words, 0);
     for (int i = 0; i < m; ++i) {
-        std::vector<std::vector<int>> embedding_all_pj_into_si;
-        embedding_all_pj_into_si.reserve(p);
+        const auto& s = S[i];
+        for (int j = (int)s.size() - 1; j >= 0; --j) {
+            uint64_t* masks = remaining_letters_mask.data() + (s_offsets[i] + j) * mask_words;
+            std::copy_n(masks + mask_words, mask_words, masks);
+            if (s[j] < Sigma)
+                masks[s[j] / 64] |= uint64_t(1) << (s[j] % 64);
+        }
+    }
 
-        for (int j = 0; j < p; ++j) {
-            const auto& pj = P[j];
-            std::vector<int> embedding_pj_into_si(pj.size(), -1);
-            int max_index = (int)pj.size() - 1;
+    // remaining_patern_suffix_pos
+    p_offsets.resize(p + 1, 0);
+    for (int j = 0; j < p; ++j)
+        p_offsets[j + 1] = p_offsets[j] + P[j].size() + 1;
 
+    remaining_patern_suffix_pos.assign(p_offsets[p] * m, max_length <= (size_t)std::numeric_limits<int16_t>::max());
+    for (int j = 0; j < p; ++j) {
+        const auto& pj = P[j];
+        for (int i = 0; i < m; ++i) {
             const auto& si = S[i];
+            auto at = [&](int px) { return (p_offsets[j] + px) * m + i; };
+
+            for (int px = 0; px < (int)pj.size(); ++px)
+                remaining_patern_suffix_pos.set(at(px), -1);
+            remaining_patern_suffix_pos.set(at(pj.size()), (int)si.size());
+
+            int max_index = (int)pj.size() - 1;
             for (int its = (int)si.size() - 1; its >= 0 && max_index >= 0; --its) {
                 if (pj[max_index] == si[its]) {
-                    embedding_pj_into_si[max_index] = its;
+                    remaining_patern_suffix_pos.set(at(max_index), its);
                     --max_index;
                 }
             }
-            embedding_all_pj_into_si.push_back(std::move(embedding_pj_into_si));
         }
-        remaining_patern_suffix_pos[i] = std::move(embedding_all_pj_into_si);
     }
 }
 
+void Instance::build_suffix_lcs()
+{
+    if (!lcs_offsets.empty() || m < 2) return;
+
+    size_t max_length = 0;
+    lcs_offsets.resize(m, 0);
+    for (int i = 0; i + 1 < m; ++i) {
+        lcs_offsets[i + 1] = lcs_offsets[i] + (S[i].size() + 1) * (S[i + 1].size() + 1);
+        max_length = std::max(max_length, S[i].size());
+    }
+
+    suffix_lcs.assign(lcs_offsets[m - 1], max_length <= std::numeric_limits<uint16_t>::max());
+    for (int i = 0; i + 1 < m; ++i) {
+        const auto& a = S[i];
+        const auto& b = S[i + 1];
+        const size_t columns = b.size() + 1;
+        auto at = [&](size_t x, size_t y) { return lcs_offsets[i] + x * columns + y; };
+
+        // the row x = |a| and the column y = |b| stay 0
+        for (int x = (int)a.size() - 1; x >= 0; --x) {
+            for (int y = (int)b.size() - 1; y >= 0; --y) {
+                int value = (a[x] == b[y]) ? suffix_lcs[at(x + 1, y + 1)] + 1
+                                           : std::max(suffix_lcs[at(x + 1, y)], suffix_lcs[at(x, y + 1)]);
+                suffix_lcs.set(at(x, y), value);
+            }
+        }
+    }
+}
+
+size_t Instance::table_bytes() const
+{
+    return occurances_string_pos_char.bytes() + next_char_occurance_in_strings.bytes() +
+           remaining_letters_mask.size() * sizeof(uint64_t) + remaining_patern_suffix_pos.bytes() +
+           (s_offsets.size() + p_offsets.size()) * sizeof(size_t);
+}
+
 Instance::~Instance()
 {
     S.clear();
     P.clear();
     R.clear();
-    map_char_to_int.clear();
     int2char.clear();
 }
 
+
+// Layout of a binary instance file: this header, then 8-byte aligned sections at
+// the given offsets from the start of the file
+namespace {
+
+constexpr char binary_magic[8] = {'R', 'L', 'C', 'S', 'B', 'I', 'N', '1'};
+
+struct BinaryHeader {
+    char magic[8];
+    int32_t m, Sigma, p, r, mask_words;
+    int32_t letters;                                        // letters met in the strings (may differ from Sigma)
+    int32_t narrow_occurrences, narrow_next, narrow_suffix; // entry width of the position tables
+    uint64_t rows, suffix_rows;                             // s_offsets[m], p_offsets[p]
+    uint64_t alphabet;                                      // one char per letter, letter -> char
+    uint64_t string_lengths, strings;                       // m + p + r lengths, then the letters (int32)
+    uint64_t s_offsets, p_offsets;                          // m + 1 and p + 1 uint64
+    uint64_t occurrences, next, masks, suffix;              // the preprocessed tables
+    uint64_t file_size;
+};
+
+size_t aligned(size_t offset) { return (offset + 7) / 8 * 8; }
+
+// Sets the section offsets and file size of header from its counts, for n_strings
+// strings of total_length letters, in the order save_binary() writes the sections
+void set_layout(BinaryHeader& header, uint64_t n_strings, uint64_t total_length)
+{
+    auto entries = [](int32_t narrow, size_t narrow_width) { return narrow ? narrow_width : sizeof(int32_t); };
+    size_t offset = aligned(sizeof(BinaryHeader));
+    auto section = [&offset](size_t bytes) {
+        size_t start = offset;
+        offset = aligned(offset + bytes);
+        return start;
+    };
+    header.alphabet = section(header.letters);
+    header.string_lengths = section(n_strings * sizeof(int32_t));
+    header.strings = section(total_length * sizeof(int32_t));
+    header.s_offsets = section((header.m + 1) * sizeof(uint64_t));
+    header.p_offsets = section((header.p + 1) * sizeof(uint64_t));
+    header.occurrences = section(header.rows * header.Sigma * entries(header.narrow_occurrences, sizeof(uint16_t)));
+    header.next = section(header.rows * header.Sigma * entries(header.narrow_next, sizeof(uint16_t)));
+    header.masks = section(header.rows * header.mask_words * sizeof(uint64_t));
+    header.suffix = section(header.suffix_rows * header.m * entries(header.narrow_suffix, sizeof(int16_t)));
+    header.file_size = offset;
+}
+
+} // namespace
+
+bool Instance::is_binary_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(binary_magic)] = {};
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, binary_magic, sizeof(magic)) == 0;
+}
+
+void Instance::save_binary(const std::string& path) const
+{
+    std::vector<const std::vector<int>*> strings;
+    for (const auto& s : S) strings.push_back(&s);
+    for (const auto& s : P) strings.push_back(&s);
+    for (const auto& s : R) strings.push_back(&s);
+    size_t total_length = 0;
+    for (const auto* s : strings) total_length += s->size();
+
+    BinaryHeader header = {};
+    std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+    header.m = m;
+    header.Sigma = Sigma;
+    header.p = p;
+    header.r = r;
+    header.mask_words = mask_words;
+    header.letters = int2char.size();
+    header.narrow_occurrences = occurances_string_pos_char.narrow_entries();
+    header.narrow_next = next_char_occurance_in_strings.narrow_entries();
+    header.narrow_suffix = remaining_patern_suffix_pos.narrow_entries();
+    header.rows = s_offsets[m];
+    header.suffix_rows = p_offsets[p];
+
+    set_layout(header, strings.size(), total_length);
+
+    std::vector<char> buffer(header.file_size, 0);
+    auto write = [&buffer](size_t at, const void* data, size_t bytes) {
+        if (bytes > 0) std::memcpy(buffer.data() + at, data, bytes);
+    };
+
+    write(0, &header, sizeof(header));
+    std::copy(int2char.begin(), int2char.end(), buffer.begin() + header.alphabet);
+
+    size_t at = header.strings;
+    for (size_t k = 0; k < strings.size(); ++k) {
+        int32_t length = strings[k]->size();
+        write(header.string_lengths + k * sizeof(int32_t), &length, sizeof(length));
+        std::vector<int32_t> letters(strings[k]->begin(), strings[k]->end());
+        write(at, letters.data(), letters.size() * sizeof(int32_t));
+        at += letters.size() * sizeof(int32_t);
+    }
+
+    std::vector<uint64_t> offsets(s_offsets.begin(), s_offsets.end());
+    write(header.s_offsets, offsets.data(), offsets.size() * sizeof(uint64_t));
+    offsets.assign(p_offsets.begin(), p_offsets.end());
+    write(header.p_offsets, offsets.data(), offsets.size() * sizeof(uint64_t));
+
+    write(header.occurrences, occurances_string_pos_char.data(), occurances_string_pos_char.bytes());
+    write(header.next, next_char_occurance_in_strings.data(), next_char_occurance_in_strings.bytes());
+    write(header.masks, remaining_letters_mask.data(), remaining_letters_mask.size() * sizeof(uint64_t));
+    write(header.suffix, remaining_patern_suffix_pos.data(), remaining_patern_suffix_pos.bytes());
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out.write(buffer.data(), buffer.size())) {
+        std::cerr << "Error writing the file: " << path << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+void Instance::load_binary(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(BinaryHeader)) {
+        if (fd >= 0) close(fd);
+        throw std::runtime_error("Error opening the file: " + path);
+    }
+    size_t file_size = st.st_size;
+    void* address = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("Error mapping the file: " + path);
+    }
+    mapping = std::shared_ptr<const void>(address, [file_size](const void* a) { munmap(const_cast<void*>(a), file_size); });
+
+    const char* base = static_cast<const char*>(address);
+    BinaryHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    auto corrupted = [&path]() {
+        return std::runtime_error("Error: truncated or corrupted binary instance file: " + path);
+    };
+
+    // every section must lie inside the mapping: a section at offset holding a * b
+    // entries of width bytes, checked by divisions so that no product overflows
+    auto fits = [file_size](uint64_t offset, uint64_t a, uint64_t b, uint64_t width) {
+        if (offset % 8 != 0 || offset > file_size) return false;
+        uint64_t room = (file_size - offset) / width;
+        return a == 0 || b == 0 || (b <= room && a <= room / b);
+    };
+    auto entry_width = [](int32_t narrow, uint64_t narrow_width) { return narrow ? narrow_width : sizeof(int32_t); };
+
+    if (header.file_size != file_size || header.m < 0 || header.Sigma < 0 || header.p < 0 || header.r < 0 ||
+        header.mask_words != (header.Sigma + 63) / 64 || header.letters < 0 || header.letters > 256)
+        throw corrupted();
+
+    const uint64_t n_strings = uint64_t(header.m) + header.p + header.r;
+    if (!fits(header.alphabet, header.letters, 1, 1) ||
+        !fits(header.string_lengths, n_strings, 1, sizeof(int32_t)) ||
+        !fits(header.s_offsets, uint64_t(header.m) + 1, 1, sizeof(uint64_t)) ||
+        !fits(header.p_offsets, uint64_t(header.p) + 1, 1, sizeof(uint64_t)))
+        throw corrupted();
+
+    const int32_t* lengths = reinterpret_cast<const int32_t*>(base + header.string_lengths);
+    uint64_t total_length = 0;
+    for (uint64_t k = 0; k < n_strings; ++k) {
+        if (lengths[k] < 0) throw corrupted();
+        total_length += lengths[k];
+    }
+    if (!fits(header.strings, total_length, 1, sizeof(int32_t)))
+        throw corrupted();
+
+    // the row offsets must follow from the string lengths, as fill_in_data_structures() builds them
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + header.s_offsets);
+    if (offsets[0] != 0) throw corrupted();
+    for (int i = 0; i < header.m; ++i)
+        if (offsets[i + 1] != offsets[i] + lengths[i] + 1) throw corrupted();
+    if (offsets[header.m] != header.rows) throw corrupted();
+    offsets = reinterpret_cast<const uint64_t*>(base + header.p_offsets);
+    if (offsets[0] != 0) throw corrupted();
+    for (int j = 0; j < header.p; ++j)
+        if (offsets[j + 1] != offsets[j] + lengths[header.m + j] + 1) throw corrupted();
+    if (offsets[header.p] != header.suffix_rows) throw corrupted();
+
+    if (!fits(header.occurrences, header.rows, header.Sigma, entry_width(header.narrow_occurrences, sizeof(uint16_t))) ||
+        !fits(header.next, header.rows, header.Sigma, entry_width(header.narrow_next, sizeof(uint16_t))) ||
+        !fits(header.masks, header.rows, header.mask_words, sizeof(uint64_t)) ||
+        !fits(header.suffix, header.suffix_rows, header.m, entry_width(header.narrow_suffix, sizeof(int16_t))))
+        throw corrupted();
+
+    // the tables are used as they are, so their sizes must match the counts exactly
+    BinaryHeader expected = header;
+    set_layout(expected, n_strings, total_length);
+    if (std::memcmp(&expected, &header, sizeof(header)) != 0)
+        throw corrupted();
+
+    // letters index the alphabet when solutions are written
+    const int32_t* letters = reinterpret_cast<const int32_t*>(base + header.strings);
+    for (uint64_t k = 0; k < total_length; ++k)
+        if (letters[k] < 0 || letters[k] >= header.letters) throw corrupted();
+
+    m = header.m;
+    Sigma = header.Sigma;
+    p = header.p;
+    r = header.r;
+    mask_words = header.mask_words;
+
+    map_char_to_int.fill(-1);
+    int2char.assign(base + header.alphabet, base + header.alphabet + header.letters);
+    for (int a = 0; a < header.letters; ++a)
+        map_char_to_int[(unsigned char)int2char[a]] = a;
+
+    // the strings are small and read everywhere as vectors, so they are copied
+    for (int k = 0; k < m + p + r; ++k) {
+        auto& target = (k < m) ? S : (k < m + p) ? P : R;
+        target.emplace_back(letters, letters + lengths[k]);
+        letters += lengths[k];
+    }
+
+    offsets = reinterpret_cast<const uint64_t*>(base + header.s_offsets);
+    s_offsets.assign(offsets, offsets + m + 1);
+    offsets = reinterpret_cast<const uint64_t*>(base + header.p_offsets);
+    p_offsets.assign(offsets, offsets + p + 1);
+
+    occurances_string_pos_char.map(base + header.occurrences, header.rows * Sigma, header.narrow_occurrences);
+    next_char_occurance_in_strings.map(base + header.next, header.rows * Sigma, header.narrow_next);
+    remaining_letters_mask.map(reinterpret_cast<const uint64_t*>(base + header.masks), header.rows * mask_words);
+    remaining_patern_suffix_pos.map(base + header.suffix, header.suffix_rows * m, header.narrow_suffix);
+}
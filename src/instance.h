@@ -1,8 +1,90 @@
 #pragma once
 
 #include <vector>
-#include <map>
+#include <array>
+#include <string_view>
+#include <memory>
 #include <string>
+#include <istream>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only array that either owns its elements or views elements stored elsewhere,
+// i.e. in a memory-mapped binary instance file. Copies of an owning table own a
+// copy of the elements; copies of a view share the viewed memory.
+template <typename T>
+class Table {
+public:
+    Table() = default;
+    Table(Table&&) noexcept = default;
+    Table& operator=(Table&&) noexcept = default;
+    Table(const Table& other) : owned(other.owned), view(other.is_view() ? other.view : owned.data()), n(other.n) {}
+    Table& operator=(const Table& other) {
+        owned = other.owned;
+        view = other.is_view() ? other.view : owned.data();
+        n = other.n;
+        return *this;
+    }
+
+    void assign(size_t size, T value) {
+        owned.assign(size, value);
+        view = owned.data();
+        n = size;
+    }
+
+    void map(const T* data, size_t size) {
+        owned.clear();
+        view = data;
+        n = size;
+    }
+
+    const T& operator[](size_t idx) const { return view[idx]; }
+    T* data() { return owned.data(); } // only for owning tables
+    const T* data() const { return view; }
+    size_t size() const { return n; }
+
+private:
+    std::vector<T> owned;
+    const T* view = nullptr;
+    size_t n = 0;
+
+    bool is_view() const { return view != nullptr && view != owned.data(); }
+};
+
+// Table of string positions, stored with Narrow entries when every value fits in
+// them (i.e. all strings are short enough) and with 32-bit entries otherwise.
+template <typename Narrow>
+class PositionTable {
+public:
+    void assign(size_t size, bool narrow_fits) {
+        is_narrow = narrow_fits;
+        narrow.assign(is_narrow ? size : 0, 0);
+        wide.assign(is_narrow ? 0 : size, 0);
+    }
+
+    // views size entries stored at data, Narrow if narrow_entries and 32-bit otherwise
+    void map(const void* data, size_t size, bool narrow_entries) {
+        is_narrow = narrow_entries;
+        narrow.map(is_narrow ? static_cast<const Narrow*>(data) : nullptr, is_narrow ? size : 0);
+        wide.map(is_narrow ? nullptr : static_cast<const int32_t*>(data), is_narrow ? 0 : size);
+    }
+
+    int operator[](size_t idx) const { return is_narrow ? narrow[idx] : wide[idx]; }
+
+    void set(size_t idx, int value) {
+        if (is_narrow) narrow.data()[idx] = static_cast<Narrow>(value);
+        else wide.data()[idx] = value;
+    }
+
+    bool narrow_entries() const { return is_narrow; }
+    const void* data() const { return is_narrow ? static_cast<const void*>(narrow.data()) : wide.data(); }
+    size_t bytes() const { return narrow.size() * sizeof(Narrow) + wide.size() * sizeof(int32_t); }
+
+private:
+    bool is_narrow = true;
+    Table<Narrow> narrow;
+    Table<int32_t> wide;
+};
 
 class Instance
 {
@@ -17,22 +99,54 @@ public:
     std::vector<std::vector<int>> P; // P-strings encoded as int vectors
     std::vector<std::vector<int>> R; // R-strings encoded as int vectors
 
-    std::map<char, int> map_char_to_int;  // char -> int mapping for alphabet
-    std::map<int, char> int2char;         // reverse mapping
+    std::array<int, 256> map_char_to_int; // char (as unsigned char) -> letter, -1 if absent
+    std::vector<char> int2char;           // letter -> char
 
-    //vectors for various preprocessed info:
-    // occurances_string_pos_char[char][i][j] = number of occurrences of char in S[i][j..end]
-    std::vector<std::vector<std::vector<int>>> occurances_string_pos_char;
+    // preprocessed tables, flattened in the order expansion reads them: one row per
+    // (S string i, position pos) with row index s_offsets[i] + pos, pos = 0..|S[i]|
+    std::vector<size_t> s_offsets;
 
-    // next_char_occurance_in_strings[char][i][j] = position of next occurrence of char in S[i] at or after index j
-    std::vector<std::vector<std::vector<int>>> next_char_occurance_in_strings;
+    // occurances_string_pos_char[row * Sigma + char] = number of occurrences of char in S[i][pos..end]
+    PositionTable<uint16_t> occurances_string_pos_char;
 
-    // remaining_patern_suffix_pos[i][j][px] = max index of S[i] where P[j][px..end] can be embedded
-    std::vector<std::vector<std::vector<int>>> remaining_patern_suffix_pos;
+    // next_char_occurance_in_strings[row * Sigma + char] = position of next occurrence of char in S[i]
+    // at or after pos (|S[i]| if there is none)
+    PositionTable<uint16_t> next_char_occurance_in_strings;
+
+    // remaining_letters_mask[row * mask_words + w] = word w of the bit set of letters occurring in
+    // S[i][pos..end], so the letters available at a node are the AND over all strings
+    int mask_words = 0;
+    Table<uint64_t> remaining_letters_mask;
+
+    // remaining_patern_suffix_pos[(p_offsets[j] + px) * m + i] = max index of S[i] where P[j][px..end]
+    // can be embedded (-1 if it cannot); px = |P[j]| gives |S[i]|
+    std::vector<size_t> p_offsets;
+    PositionTable<int16_t> remaining_patern_suffix_pos;
+
+    // suffix_lcs[lcs_offsets[i] + x * (|S[i + 1]| + 1) + y] = LCS length of S[i][x..] and S[i + 1][y..],
+    // for consecutive pairs of S strings. Only built by build_suffix_lcs(), for the upper bound.
+    std::vector<size_t> lcs_offsets;
+    PositionTable<uint16_t> suffix_lcs;
+
+    std::shared_ptr<const void> mapping; // mapped binary file the tables view, if any
 
 public:
+    // an instance file, either text or binary (see save_binary()). Files that cannot
+    // be read or are not valid instances throw std::runtime_error.
     explicit Instance(const std::string& path);
+    Instance(std::istream& in, const std::string& name); // instance text read from in
     ~Instance();
 
+    void read(std::istream& in);
+    void set_strings(const std::vector<std::string_view>& strings);
     void fill_in_data_structures();
+    void build_suffix_lcs();
+
+    // Binary instance files hold the encoded strings, the alphabet and every
+    // preprocessed table in native byte order. Loading one maps the file and the
+    // tables are used in place, without parsing or preprocessing.
+    void save_binary(const std::string& path) const;
+    void load_binary(const std::string& path);
+    static bool is_binary_file(const std::string& path);
+    size_t table_bytes() const; // memory held by the preprocessed tables
 };
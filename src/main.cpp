@@ -5,6 +5,9 @@
 #include <string>
 #include <vector>
 #include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
 #include "beam_search.h"
 #include "nnet.h"
 #include "instance.h"
@@ -24,8 +27,17 @@ int beam_width;
 double time_limit;
 int hidden_layers;
 int num_threads;
+int solve_threads = 1;
+int anytime_beam_width = 0;
+size_t memory_limit = 0; // bytes, 0 = unlimited
+bool profile = false;
+int upper_bound = 0;
+int incumbent = 0;
+int dominance_references = 0;
 int num_features;
 std::string filename;
+std::string batch_filename;
+bool service = false;
 
 std::vector<int> units;
 std::vector<std::string> training_files;
@@ -37,6 +49,7 @@ void read_parameters(int argc, char** argv) {
         std::string arg = argv[i];
         if (arg == "-weight_limit") neural_network.weight_limit = std::stoi(argv[++i]);
         else if (arg == "-training_beam_width") neural_network.training_beam_width = std::stoi(argv[++i]);
+        else if (arg == "-training_node_budget") neural_network.training_node_budget = std::stoll(argv[++i]);
         else if (arg == "-training_time_limit") neural_network.training_time_limit = std::stod(argv[++i]);
         else if (arg == "-hidden_layers") hidden_layers = std::stoi(argv[++i]);
         else if (arg == "-units") {
@@ -45,6 +58,8 @@ void read_parameters(int argc, char** argv) {
         }
         else if (arg == "-time_limit") time_limit = std::stod(argv[++i]);
         else if (arg == "-i") { training = false; filename = argv[++i]; }
+        else if (arg == "-batch") { training = false; batch_filename = argv[++i]; }
+        else if (arg == "-serve") { training = false; service = true; }
         else if (arg == "-o") neural_network.output_filename = argv[++i];
         else if (arg == "-beam_width") beam_width = std::stoi(argv[++i]);
         else if (arg == "-activation_function") neural_network.activation_function = std::stoi(argv[++i]);
@@ -63,8 +78,20 @@ void read_parameters(int argc, char** argv) {
         else if (arg == "-n_elites") neural_network.n_elites = std::stoi(argv[++i]);
         else if (arg == "-n_mutants") neural_network.n_mutants = std::stoi(argv[++i]);
         else if (arg == "-rho") neural_network.elite_inheritance_probability = std::stod(argv[++i]);
+        else if (arg == "-seed") neural_network.seed = std::stoull(argv[++i]);
+        else if (arg == "-screening_beam_width") neural_network.screening_beam_width = std::stoi(argv[++i]);
+        else if (arg == "-screening_instances") neural_network.screening_instances = std::stoi(argv[++i]);
+        else if (arg == "-promotion_fraction") neural_network.promotion_fraction = std::stod(argv[++i]);
+        else if (arg == "-racing") neural_network.racing = std::stoi(argv[++i]);
         else if (arg == "-parallel") parallel = true;
         else if (arg == "-num_threads") num_threads = std::stoi(argv[++i]);
+        else if (arg == "-solve_threads") solve_threads = std::stoi(argv[++i]);
+        else if (arg == "-anytime") anytime_beam_width = std::stoi(argv[++i]);
+        else if (arg == "-profile") profile = true;
+        else if (arg == "-upper_bound") upper_bound = std::stoi(argv[++i]);
+        else if (arg == "-incumbent") incumbent = std::stoi(argv[++i]);
+        else if (arg == "-dominance") dominance_references = std::stoi(argv[++i]);
+        else if (arg == "-memory_limit") memory_limit = std::stoull(argv[++i]) << 20;
         ++i;
     }
 
@@ -92,6 +119,16 @@ void read_parameters(int argc, char** argv) {
     }
 }
 
+// Instance at path, exiting on errors (every mode but -batch and -serve)
+Instance read_instance(const std::string& path) {
+    try {
+        return Instance(path);
+    } catch (const std::runtime_error& error) {
+        std::cerr << error.what() << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
 void set_up_neural_network() {
     // Define architecture
     neural_network.units_per_layer.push_back(num_features);
@@ -125,8 +162,8 @@ void set_up_neural_network() {
 
         neural_network.training_instances.reserve(training_files.size());
         neural_network.validation_instances.reserve(validation_files.size());
-        for (const auto& file : training_files) neural_network.training_instances.emplace_back(Instance(file));
-        for (const auto& file : validation_files) neural_network.validation_instances.emplace_back(Instance(file));
+        for (const auto& file : training_files) neural_network.training_instances.emplace_back(read_instance(file));
+        for (const auto& file : validation_files) neural_network.validation_instances.emplace_back(read_instance(file));
 
     } else {
         std::ifstream weights_in("weights.txt");
@@ -157,6 +194,160 @@ void set_up_neural_network() {
     }
 }
 
+// BS() options from the command line, for solving instance
+BSOptions solve_options(Instance& instance) {
+    BSOptions options;
+    options.n_threads = solve_threads;
+    options.memory_limit = memory_limit;
+    options.upper_bound = upper_bound;
+    options.incumbent = incumbent;
+    options.dominance_references = dominance_references;
+    if (upper_bound >= 2)
+        instance.build_suffix_lcs();
+    return options;
+}
+
+void report_throughput(size_t n_instances, std::chrono::steady_clock::time_point start) {
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << "Solved " << n_instances << " instances in " << elapsed << " s ("
+              << n_instances / elapsed << " instances/s).\n";
+}
+
+// Solves every instance listed in batch_filename (one path per line) in this
+// process, num_threads instances at a time. Results are written in completion order;
+// a file that cannot be read gets an error record and the batch goes on.
+void solve_batch() {
+    std::ifstream list(batch_filename);
+    if (!list) {
+        std::cerr << "Error: Could not open '" << batch_filename << "'.\n";
+        exit(EXIT_FAILURE);
+    }
+    std::vector<std::string> files;
+    std::string file;
+    while (std::getline(list, file))
+        if (!file.empty()) files.push_back(file);
+
+    std::ofstream output_file;
+    if (!neural_network.output_filename.empty()) {
+        output_file.open(neural_network.output_filename);
+        if (!output_file) {
+            std::cerr << "Error opening the file." << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        output_file << std::setprecision(10) << std::fixed;
+    }
+    std::ostream& out = output_file.is_open() ? output_file : std::cout;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t solved = 0;
+
+    #pragma omp parallel for schedule(dynamic) num_threads(std::max(num_threads, 1))
+    for (size_t f = 0; f < files.size(); ++f) {
+        try {
+            Instance instance(files[f]);
+            BSResult result = BS(time_limit, beam_width, &instance, neural_network, solve_options(instance));
+
+            #pragma omp critical(batch_output)
+            {
+                write_result(out, &instance, result);
+                ++solved;
+            }
+        } catch (const std::runtime_error& error) {
+            std::cerr << error.what() << std::endl;
+            #pragma omp critical(batch_output)
+            write_error(out, files[f], error.what());
+        }
+    }
+
+    report_throughput(solved, start);
+}
+
+// true if line has the "<length> <string>" form of the string lines of an instance
+bool is_string_line(const std::string& line) {
+    std::istringstream fields(line);
+    int length;
+    std::string letters, extra;
+    return (fields >> length) && length >= 0 && (fields >> letters) && !(fields >> extra);
+}
+
+// Service mode: solves the requests read from the standard input until its end
+// with the loaded network, num_threads at a time, and writes one result record
+// per instance to the standard output in completion order. A request is either
+// an instance path on one line, or the instance text itself: its "m Sigma p r"
+// header line followed by its m + p + r string lines. A request that cannot be
+// read gets an error record (its name, then the error) and the service goes on;
+// an inline request ends early at the first line that is not a string line,
+// which is then read as the next request.
+void serve() {
+    auto start = std::chrono::steady_clock::now();
+    const int workers = std::max(num_threads, 1);
+    size_t solved = 0;
+
+    // reads a request with load() and solves it
+    auto solve = [&solved](const std::string& name, auto load) {
+        try {
+            Instance instance = load();
+            BSResult result = BS(time_limit, beam_width, &instance, neural_network, solve_options(instance));
+            #pragma omp critical(service_output)
+            {
+                write_result(std::cout, &instance, result);
+                ++solved;
+            }
+        } catch (const std::runtime_error& error) {
+            std::cerr << error.what() << std::endl;
+            #pragma omp critical(service_output)
+            write_error(std::cout, name, error.what());
+        }
+    };
+
+    // one thread reads the requests and hands them out as tasks to the others
+    #pragma omp parallel num_threads(workers)
+    #pragma omp single
+    {
+        std::string line;
+        bool pending = false; // line holds the next request, read while collecting the previous one
+        for (int request = 0; pending || std::getline(std::cin, line); ++request) {
+            pending = false;
+            if (line.empty()) continue;
+
+            std::istringstream header(line);
+            int m, sigma, p, r;
+            if (header >> m >> sigma >> p >> r) {
+                std::string text = line + '\n';
+                int strings = 0;
+                while (strings < m + p + r && std::getline(std::cin, line)) {
+                    if (!is_string_line(line)) {
+                        pending = true;
+                        break;
+                    }
+                    text += line + '\n';
+                    ++strings;
+                }
+                std::string name = "stdin_" + std::to_string(request);
+
+                if (strings < m + p + r) {
+                    std::string message = "Error: expected " + std::to_string(m + p + r) + " strings in request " + name;
+                    std::cerr << message << std::endl;
+                    #pragma omp critical(service_output)
+                    write_error(std::cout, name, message);
+                    continue;
+                }
+
+                #pragma omp task firstprivate(text, name) if(workers > 1)
+                solve(name, [&text, &name]() {
+                    std::istringstream in(text);
+                    return Instance(in, name);
+                });
+            } else {
+                #pragma omp task firstprivate(line) if(workers > 1)
+                solve(line, [&line]() { return Instance(line); });
+            }
+        }
+    }
+
+    report_throughput(solved, start);
+}
+
 int main(int argc, char** argv) {
     read_parameters(argc, argv);
 
@@ -169,11 +360,43 @@ int main(int argc, char** argv) {
         std::ofstream weights_out("last_weights.txt");
         for (double w : final_weights)
             weights_out << w << " ";
+    } else if (service) {
+        serve();
+    } else if (!batch_filename.empty()) {
+        solve_batch();
+    } else if (anytime_beam_width > 0) {
+        Instance instance = read_instance(filename);
+        std::ofstream output_file;
+        if (!neural_network.output_filename.empty()) {
+            output_file.open(neural_network.output_filename);
+            if (!output_file) {
+                std::cerr << "Error opening the file." << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            output_file << std::setprecision(10) << std::fixed;
+        }
+        std::ostream& out = output_file.is_open() ? output_file : std::cout;
+        anytime_BS(time_limit, anytime_beam_width, &instance, neural_network, solve_options(instance), out);
     } else {
-        auto* instance = new Instance(filename);
-        BS(time_limit, beam_width, instance, neural_network, false);
+        auto* instance = new Instance(read_instance(filename));
+        std::vector<LevelStats> level_stats;
+        BSOptions options = solve_options(*instance);
+        if (profile) options.level_stats = &level_stats;
+        BSResult result = BS(time_limit, beam_width, instance, neural_network, options);
+        save_in_file(neural_network.output_filename, instance, result);
+        if (profile)
+            write_level_stats(neural_network.output_filename.empty() ? "levels.csv"
+                                                                     : neural_network.output_filename + ".levels.csv",
+                              level_stats);
+        if (dominance_references > 0)
+            std::cerr << "Dominated nodes removed: " << result.dominated_nodes << "\n";
+        if (result.beam_width < beam_width)
+            std::cerr << "Beam width lowered to " << result.beam_width << " by the memory limit.\n";
         delete instance;
     }
 
+    if (!training)
+        std::cerr << "Peak memory: " << peak_memory_mb() << " MB\n";
+
     return 0;
 }
@@ -1,38 +1,43 @@
 #include "nnet.h"
 #include "beam_search.h"
 #include "instance.h"
+#include "bounds.h"
 
 #include <random>
 #include <numeric>
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #ifdef _OPENMP
     #include <omp.h>
 #endif
 
 constexpr int training_bs_time_limit = 10;
 
-// random engine setup
-unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-std::default_random_engine generator(seed);
-std::uniform_real_distribution<double> standard_distribution_01(0.0, 1.0);
+// Random stream of individual `index` of generation `generation` (0 = initial
+// population). It only depends on the seed and these coordinates, so individuals
+// can be generated in any order and by any number of threads.
+std::mt19937_64 individual_stream(uint64_t seed, int generation, int index) {
+    std::seed_seq seq{uint32_t(seed), uint32_t(seed >> 32), uint32_t(generation), uint32_t(index)};
+    return std::mt19937_64(seq);
+}
 
-// activation functions
-Eigen::MatrixXd relu(const Eigen::MatrixXd& x) {
-    return x.array().max(0);
+// activation functions, applied in place
+void relu(Eigen::Ref<Eigen::MatrixXd> x) {
+    x = x.array().max(0);
 }
 
-Eigen::MatrixXd sigmoid(const Eigen::MatrixXd& x) {
-    return 1.0 / (1.0 + (-x).array().exp());
+void sigmoid(Eigen::Ref<Eigen::MatrixXd> x) {
+    x = (1.0 / (1.0 + (-x.array()).exp())).matrix();
 }
 
-void MLP::apply_activation_function(Eigen::MatrixXd& x) {
+void MLP::apply_activation_function(Eigen::Ref<Eigen::MatrixXd> x) {
     if (activation_function == 1) {
-        x = x.array().tanh();
+        x = x.array().tanh().matrix();
     } else if (activation_function == 2) {
-        x = relu(x);
+        relu(x);
     } else if (activation_function == 3) {
-        x = sigmoid(x);
+        sigmoid(x);
     }
 }
 
@@ -48,7 +53,7 @@ void print_information(double best_ofv, double ctime, int niter, double validati
     std::cout << "-----------------------------------------------------------------------------------------------------" << std::endl;
 }
 
-MLP::MLP() {}
+MLP::MLP() : seed(std::chrono::system_clock::now().time_since_epoch().count()) {}
 
 Eigen::VectorXd MLP::forward(const Eigen::VectorXd& x) {
     Eigen::MatrixXd prev = x;
@@ -60,6 +65,42 @@ Eigen::VectorXd MLP::forward(const Eigen::VectorXd& x) {
     return prev;
 }
 
+// Evaluates the network on every column of X at once. Architectures with a
+// compiled FixedMLP kernel use it; any other shape runs one matrix-matrix product
+// per layer. layer_outputs is caller-owned scratch (one matrix per layer) that only
+// grows, so repeated calls do not allocate; the network output for column c is
+// returned in column c of the first row. The products are summed in a different
+// order than in forward(), so values may differ from it in the last bits (make
+// bench reports the largest difference; ~1e-14 on outputs of order 1-10).
+const Eigen::MatrixXd& MLP::forward_batch(const Eigen::Ref<const Eigen::MatrixXd>& X,
+                                          std::vector<Eigen::MatrixXd>& layer_outputs) {
+    const Eigen::Index n = X.cols();
+    layer_outputs.resize(units_per_layer.size() - 1);
+
+    if (fixed_network) {
+        Eigen::MatrixXd& output = layer_outputs.back();
+        if (output.rows() != 1 || output.cols() < n)
+            output.resize(1, std::max<Eigen::Index>(n, 2 * output.cols()));
+        fixed_network->forward_batch(X, output.data());
+        return output;
+    }
+
+    for (size_t i = 0; i < units_per_layer.size() - 1; ++i) {
+        Eigen::MatrixXd& buffer = layer_outputs[i];
+        if (buffer.rows() != weight_matrices[i].rows() || buffer.cols() < n)
+            buffer.resize(weight_matrices[i].rows(), std::max<Eigen::Index>(n, 2 * buffer.cols()));
+
+        auto y = buffer.leftCols(n);
+        if (i == 0)
+            y.noalias() = weight_matrices[i] * X;
+        else
+            y.noalias() = weight_matrices[i] * layer_outputs[i - 1].leftCols(n);
+        y.colwise() += bias_vectors[i].col(0);
+        apply_activation_function(y);
+    }
+    return layer_outputs.back();
+}
+
 void MLP::write_weights_to_file(const std::vector<double>& weights, double time) {
     std::ofstream weights_file("weights_" + std::to_string(time) + ".txt");
     for (double weight : weights)
@@ -67,23 +108,161 @@ void MLP::write_weights_to_file(const std::vector<double>& weights, double time)
 }
 
 double MLP::calculate_validation_value(const std::vector<double>& weights) {
-    store_weights(weights);
+    MLP network = with_weights(weights);
     double validation_value = 0.0;
-    #pragma omp parallel for reduction(+:validation_value)
+    #pragma omp parallel for schedule(dynamic) reduction(+:validation_value)
     for (size_t i = 0; i < validation_instances.size(); ++i) {
-        validation_value += BS(training_bs_time_limit, training_beam_width, &validation_instances[i], *this, true);
+        validation_value += training_run(&validation_instances[i], network, training_beam_width);
     }
     return validation_value / validation_instances.size();
 }
 
-void MLP::apply_decoder(training_individual& ind) {
-    store_weights(ind.weights);
-    double ofv = 0.0;
-    #pragma omp parallel for reduction(+:ofv)
-    for (size_t i = 0; i < training_instances.size(); ++i) {
-        ofv += BS(training_bs_time_limit, training_beam_width, &training_instances[i], *this, true);
+// Evaluates individuals [begin, end) on every training instance. All the
+// (individual, instance) BS runs form one pool handed out dynamically to the
+// threads, so a slow instance does not hold back the rest of the generation.
+// Each individual gets its own network, the shared weights of *this are untouched.
+// The runs are handed out instance by instance, so the first instances of every
+// individual are done first.
+//
+// With a cutoff (racing), the instances are evaluated in instance_order (default:
+// as listed) and an individual is cut off once the values of a completed prefix
+// of that order plus the training_bounds of the rest show that its ofv cannot
+// exceed cutoff. Its remaining runs are skipped and count 0, so its ofv is a lower
+// bound. The cut only depends on completed prefixes and values found past it are
+// dropped, so the result does not depend on the number of threads. Returns the
+// number of BS runs skipped.
+size_t MLP::apply_decoder(std::vector<training_individual>& individuals, size_t begin, size_t end,
+                          double cutoff, const std::vector<int>& instance_order) {
+    const size_t n_instances = training_instances.size();
+    const bool race = cutoff > std::numeric_limits<double>::lowest();
+
+    std::vector<int> order = instance_order;
+    if (order.empty()) {
+        order.resize(n_instances);
+        std::iota(order.begin(), order.end(), 0);
+    }
+
+    std::vector<MLP> networks;
+    networks.reserve(end - begin);
+    for (size_t k = begin; k < end; ++k) {
+        networks.push_back(with_weights(individuals[k].weights));
+        individuals[k].instance_values.assign(n_instances, 0.0);
+    }
+
+    // racing state per individual: runs done, length of the completed prefix of the
+    // order, its values plus the bounds of the rest, and the position it was cut at
+    std::vector<std::vector<char>> done(race ? end - begin : 0, std::vector<char>(n_instances, 0));
+    std::vector<size_t> prefix(end - begin, 0), cut_at(end - begin, n_instances);
+    double bound_sum = race ? std::accumulate(training_bounds.begin(), training_bounds.end(), 0.0) : 0.0;
+    std::vector<double> optimistic(end - begin, bound_sum);
+    size_t skipped = 0;
+
+    #pragma omp parallel for schedule(dynamic) reduction(+:skipped)
+    for (size_t task = 0; task < (end - begin) * n_instances; ++task) {
+        size_t k = task % (end - begin), j = task / (end - begin);
+        int i = order[j];
+        if (race) {
+            size_t cut;
+            #pragma omp atomic read
+            cut = cut_at[k];
+            if (j > cut) {
+                ++skipped;
+                continue;
+            }
+        }
+
+        double value = training_run(&training_instances[i], networks[k], training_beam_width);
+        individuals[begin + k].instance_values[i] = value;
+
+        if (race) {
+            #pragma omp critical(racing)
+            {
+                const auto& values = individuals[begin + k].instance_values;
+                done[k][j] = 1;
+                while (cut_at[k] == n_instances && prefix[k] < n_instances && done[k][prefix[k]]) {
+                    int next = order[prefix[k]];
+                    optimistic[k] += values[next] - training_bounds[next];
+                    if (optimistic[k] / n_instances <= cutoff) {
+                        #pragma omp atomic write
+                        cut_at[k] = prefix[k];
+                    }
+                    ++prefix[k];
+                }
+            }
+        }
+    }
+
+    for (size_t k = begin; k < end; ++k) {
+        auto& values = individuals[k].instance_values;
+        for (size_t j = cut_at[k - begin] + 1; j < n_instances; ++j)
+            values[order[j]] = 0.0;
+        individuals[k].ofv = std::accumulate(values.begin(), values.end(), 0.0) / n_instances;
+    }
+    return skipped;
+}
+
+// Solution length of a training or validation BS run on inst. With a
+// training_node_budget the run is bounded by it alone, so its result does not
+// depend on the machine load; otherwise by the training_bs_time_limit.
+double MLP::training_run(Instance* inst, MLP& network, int beam_width) const {
+    BSOptions options;
+    options.node_budget = training_node_budget;
+    double time_limit = (training_node_budget > 0) ? std::numeric_limits<double>::infinity() : training_bs_time_limit;
+    return BS(time_limit, beam_width, inst, network, options).length;
+}
+
+// Screening stage of the multi-fidelity evaluation: evaluates individuals
+// [begin, end) at screening_beam_width on the first screening_instances training
+// instances, setting their instance_values (0 elsewhere) and ofv (mean over the
+// screening instances). Returns the indices of the best promotion_fraction of
+// them (at least one, unless the range is empty), in increasing order, for the
+// full evaluation.
+std::vector<size_t> MLP::screen(std::vector<training_individual>& individuals, size_t begin, size_t end) {
+    if (begin == end)
+        return {};
+
+    size_t n_instances = training_instances.size();
+    if (screening_instances > 0)
+        n_instances = std::min(n_instances, size_t(screening_instances));
+
+    std::vector<MLP> networks;
+    networks.reserve(end - begin);
+    for (size_t k = begin; k < end; ++k) {
+        networks.push_back(with_weights(individuals[k].weights));
+        individuals[k].instance_values.assign(training_instances.size(), 0.0);
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t task = 0; task < (end - begin) * n_instances; ++task) {
+        size_t k = task % (end - begin), i = task / (end - begin);
+        individuals[begin + k].instance_values[i] =
+            training_run(&training_instances[i], networks[k], screening_beam_width);
     }
-    ind.ofv = ofv / training_instances.size();
+
+    std::vector<size_t> promoted(end - begin);
+    std::iota(promoted.begin(), promoted.end(), begin);
+    for (size_t k : promoted) {
+        auto& values = individuals[k].instance_values;
+        individuals[k].ofv = std::accumulate(values.begin(), values.end(), 0.0) / n_instances;
+    }
+
+    std::stable_sort(promoted.begin(), promoted.end(), [&individuals](size_t a, size_t b) {
+        return individuals[a].ofv > individuals[b].ofv;
+    });
+    size_t n_promoted = std::clamp<size_t>(std::ceil(promotion_fraction * promoted.size()), 1, promoted.size());
+    promoted.resize(n_promoted);
+    std::sort(promoted.begin(), promoted.end());
+    return promoted;
+}
+
+// Network with this architecture and the given weights, without the training data
+MLP MLP::with_weights(const std::vector<double>& weights) const {
+    MLP network;
+    network.units_per_layer = units_per_layer;
+    network.activation_function = activation_function;
+    network.feature_config = feature_config;
+    network.store_weights(weights);
+    return network;
 }
 
 void MLP::store_weights(const std::vector<double>& weights) {
@@ -108,6 +287,8 @@ void MLP::store_weights(const std::vector<double>& weights) {
 
         bias_vectors.push_back(b);
     }
+
+    fixed_network = make_fixed_mlp(*this);
 }
 
 void MLP::write_training_and_validation_values(std::ofstream& train_file,
@@ -121,8 +302,8 @@ void MLP::write_training_and_validation_values(std::ofstream& train_file,
 }
 
 std::vector<double> MLP::Train() {
-    std::uniform_real_distribution<double> weight_dist(-weight_limit, weight_limit);
-    
+    std::cerr << "Training with seed " << seed << ".\n";
+
     int n_weights = 0;
     for (size_t i = 0; i < units_per_layer.size() - 1; ++i)
         n_weights += (units_per_layer[i] + 1) * units_per_layer[i + 1];
@@ -137,36 +318,49 @@ std::vector<double> MLP::Train() {
     double ctime = 0.0;
     int niter = 0;
 
-    int n_offspring = population_size - n_elites - n_mutants;
+    if (racing > 0) {
+        training_bounds.clear();
+        for (const auto& instance : training_instances)
+            training_bounds.push_back(root_upper_bound(&instance));
+    }
+    size_t racing_skipped = 0, racing_runs = 0;
+    size_t full_evaluations = 0, screened = 0;
 
     std::vector<training_individual> population(population_size);
     std::vector<double> best_weights;
     double best_ofv = std::numeric_limits<double>::lowest();
 
+    auto record_best = [&](const training_individual& ind) {
+        if (ind.ofv <= best_ofv) return;
+        best_ofv = ind.ofv;
+        best_weights = ind.weights;
+        write_weights_to_file(best_weights, ctime);
+        double validation_value = calculate_validation_value(best_weights);
+        write_training_and_validation_values(training_file, validation_file, ctime, niter, best_ofv, validation_value);
+        print_information(best_ofv, ctime, niter, validation_value);
+    };
+
     // initialize population
-    for (int pi = 0; pi < population_size && !stop; ++pi) {
+    #pragma omp parallel for
+    for (int pi = 0; pi < population_size; ++pi) {
+        auto rng = individual_stream(seed, 0, pi);
+        std::uniform_real_distribution<double> weight_dist(-weight_limit, weight_limit);
         population[pi].weights.resize(n_weights);
         for (double& w : population[pi].weights)
-            w = weight_dist(generator);
-        
-        apply_decoder(population[pi]);
+            w = weight_dist(rng);
+    }
 
-        ctime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
-        if (ctime > training_time_limit) stop = true;
+    apply_decoder(population, 0, population_size);
 
-        if (population[pi].ofv > best_ofv) {
-            best_ofv = population[pi].ofv;
-            best_weights = population[pi].weights;
-            write_weights_to_file(best_weights, ctime);
-            double validation_value = calculate_validation_value(best_weights);
-            write_training_and_validation_values(training_file, validation_file, ctime, niter, best_ofv, validation_value);
-            print_information(best_ofv, ctime, niter, validation_value);
-        }
-    }
+    ctime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (ctime > training_time_limit) stop = true;
+
+    for (const auto& ind : population)
+        record_best(ind);
 
     while (!stop) {
-        // sort population by fitness
-        std::sort(population.begin(), population.end(), 
+        // sort population by fitness (stable, so ties keep a reproducible order)
+        std::stable_sort(population.begin(), population.end(), 
             [](const training_individual& a, const training_individual& b) {
                 return a.ofv > b.ofv;
             });
@@ -177,98 +371,138 @@ std::vector<double> MLP::Train() {
         for (int i = 0; i < n_elites; ++i)
             new_population[i] = population[i];
 
-        // mutants
-        for (int i = 0; i < n_mutants && !stop; ++i) {
-            auto& ind = new_population[n_elites + i];
-            ind.weights.resize(n_weights);
-            for (double& w : ind.weights)
-                w = weight_dist(generator);
-
-            apply_decoder(ind);
-
-            ctime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
-            if (ctime > training_time_limit) stop = true;
-
-            if (ind.ofv > best_ofv) {
-                best_ofv = ind.ofv;
-                best_weights = ind.weights;
-                write_weights_to_file(best_weights, ctime);
-                double val = calculate_validation_value(best_weights);
-                write_training_and_validation_values(training_file, validation_file, ctime, niter, best_ofv, val);
-                print_information(best_ofv, ctime, niter, val);
-            }
-        }
-
-        // offspring
-        for (int i = 0; i < n_offspring && !stop; ++i) {
-            auto& child = new_population[n_elites + n_mutants + i];
+        // mutants and offspring, each drawn from its own random stream
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = n_elites; i < population_size; ++i) {
+            auto rng = individual_stream(seed, niter + 1, i);
+            std::uniform_real_distribution<double> weight_dist(-weight_limit, weight_limit);
+            std::uniform_real_distribution<double> standard_distribution_01(0.0, 1.0);
+            auto& child = new_population[i];
             child.weights.resize(n_weights);
 
-            if (ga_config == 1) { // RKGA
+            if (i < n_elites + n_mutants) { // mutant
+                for (double& w : child.weights)
+                    w = weight_dist(rng);
+
+            } else if (ga_config == 1) { // RKGA
                 std::vector<int> idx(population_size);
                 std::iota(idx.begin(), idx.end(), 0);
-                std::shuffle(idx.begin(), idx.end(), generator);
+                std::shuffle(idx.begin(), idx.end(), rng);
                 int p1 = idx[0], p2 = idx[1];
 
                 for (int j = 0; j < n_weights; ++j)
-                    child.weights[j] = (standard_distribution_01(generator) <= 0.5) ? population[p1].weights[j] : population[p2].weights[j];
+                    child.weights[j] = (standard_distribution_01(rng) <= 0.5) ? population[p1].weights[j] : population[p2].weights[j];
 
             } else if (ga_config == 2) { // BRKGA
-                int p1 = produce_random_integer(n_elites, standard_distribution_01(generator));
-                int p2 = n_elites + produce_random_integer(population_size - n_elites, standard_distribution_01(generator));
+                int p1 = produce_random_integer(n_elites, standard_distribution_01(rng));
+                int p2 = n_elites + produce_random_integer(population_size - n_elites, standard_distribution_01(rng));
 
                 for (int j = 0; j < n_weights; ++j)
-                    child.weights[j] = (standard_distribution_01(generator) <= elite_inheritance_probability) ? population[p1].weights[j] : population[p2].weights[j];
+                    child.weights[j] = (standard_distribution_01(rng) <= elite_inheritance_probability) ? population[p1].weights[j] : population[p2].weights[j];
 
             } else if (ga_config == 3) { // Lexicase
-                std::vector<training_individual> parents;
+                // per-instance values were stored by apply_decoder(), so selection
+                // only shuffles instance indices instead of re-running BS
+                std::vector<int> parents;
                 for (int k = 0; k < 2; ++k) {
-                    auto shuffled_instances = training_instances;
-                    std::shuffle(shuffled_instances.begin(), shuffled_instances.end(), generator);
-                    std::vector<training_individual> candidates;
-                    for (auto& inst : shuffled_instances) {
+                    std::vector<int> instance_order(training_instances.size());
+                    std::iota(instance_order.begin(), instance_order.end(), 0);
+                    std::shuffle(instance_order.begin(), instance_order.end(), rng);
+                    std::vector<int> candidates;
+                    for (int inst : instance_order) {
                         double best_val = 0;
-                        for (const auto& ind : population) {
-                            store_weights(ind.weights);
-                            double val = BS(training_bs_time_limit, training_beam_width, &inst, *this, true);
+                        for (int pi = 0; pi < population_size; ++pi) {
+                            double val = population[pi].instance_values[inst];
                             if (val >= best_val) {
                                 if (val > best_val) {
                                     best_val = val;
                                     candidates.clear();
                                 }
-                                candidates.push_back(ind);
+                                candidates.push_back(pi);
                             }
                         }
                     }
-                    int sel = produce_random_integer(candidates.size(), standard_distribution_01(generator));
+                    int sel = produce_random_integer(candidates.size(), standard_distribution_01(rng));
                     parents.push_back(candidates[sel]);
                 }
 
                 for (int j = 0; j < n_weights; ++j)
-                    child.weights[j] = (standard_distribution_01(generator) <= 0.5) ? parents[0].weights[j] : parents[1].weights[j];
+                    child.weights[j] = (standard_distribution_01(rng) <= 0.5) ? population[parents[0]].weights[j] : population[parents[1]].weights[j];
             }
+        }
 
-            apply_decoder(child);
-
-            ctime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
-            if (ctime > training_time_limit) stop = true;
+        // mutants and offspring are evaluated together, all of them in full or, with
+        // screening, only those promoted by their screening score
+        std::vector<size_t> finalists(population_size - n_elites);
+        std::iota(finalists.begin(), finalists.end(), n_elites);
+        if (screening_beam_width > 0) {
+            finalists = screen(new_population, n_elites, population_size);
+            screened += population_size - n_elites;
+        }
+        full_evaluations += finalists.size();
+
+        std::vector<training_individual> evaluated;
+        evaluated.reserve(finalists.size());
+        for (size_t i : finalists)
+            evaluated.push_back(std::move(new_population[i]));
+
+        // With racing, they are cut off once they cannot enter the elite set (nor
+        // beat best_ofv without elites). The adaptive order starts with the
+        // instances the best individual is furthest from its bound on, where weak
+        // individuals lose the most.
+        if (racing > 0) {
+            double cutoff = (n_elites > 0) ? new_population[n_elites - 1].ofv : best_ofv;
+            std::vector<int> instance_order;
+            if (racing == 2) {
+                const auto& best_values = population[0].instance_values;
+                instance_order.resize(training_instances.size());
+                std::iota(instance_order.begin(), instance_order.end(), 0);
+                std::stable_sort(instance_order.begin(), instance_order.end(), [&](int a, int b) {
+                    return training_bounds[a] - best_values[a] > training_bounds[b] - best_values[b];
+                });
+            }
+            racing_skipped += apply_decoder(evaluated, 0, evaluated.size(), cutoff, instance_order);
+            racing_runs += evaluated.size() * training_instances.size();
+        } else {
+            apply_decoder(evaluated, 0, evaluated.size());
+        }
 
-            if (child.ofv > best_ofv) {
-                best_ofv = child.ofv;
-                best_weights = child.weights;
-                write_weights_to_file(best_weights, ctime);
-                double val = calculate_validation_value(best_weights);
-                write_training_and_validation_values(training_file, validation_file, ctime, niter, best_ofv, val);
-                print_information(best_ofv, ctime, niter, val);
+        for (size_t f = 0; f < finalists.size(); ++f)
+            new_population[finalists[f]] = std::move(evaluated[f]);
+
+        // screening scores are not comparable to full ones, so the individuals left
+        // out rank below every fully evaluated one and never become elites
+        if (screening_beam_width > 0) {
+            double lowest_full = std::numeric_limits<double>::max();
+            for (int i = 0; i < n_elites; ++i)
+                lowest_full = std::min(lowest_full, new_population[i].ofv);
+            for (size_t i : finalists)
+                lowest_full = std::min(lowest_full, new_population[i].ofv);
+            double below_full = std::nextafter(lowest_full, std::numeric_limits<double>::lowest());
+
+            size_t f = 0;
+            for (int i = n_elites; i < population_size; ++i) {
+                if (f < finalists.size() && finalists[f] == size_t(i)) ++f;
+                else new_population[i].ofv = std::min(new_population[i].ofv, below_full);
             }
         }
 
-        population = std::move(new_population);
         ctime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
         if (ctime > training_time_limit) stop = true;
+
+        // only full evaluations can set the best (the elites were recorded before)
+        for (size_t i : finalists)
+            record_best(new_population[i]);
+
+        population = std::move(new_population);
         ++niter;
     }
 
+    if (screening_beam_width > 0)
+        std::cout << "Screening saved " << screened - full_evaluations << " of " << screened
+                  << " full evaluations." << std::endl;
+    if (racing > 0)
+        std::cout << "Racing skipped " << racing_skipped << " of " << racing_runs << " training BS runs." << std::endl;
     std::cout << "------------ END OF TRAINING ------------" << std::endl;
     return best_weights;
 }
@@ -1,15 +1,20 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <cstdint>
+#include <limits>
 #include <fstream>
 #include <iostream>
 #include <Eigen/Dense>
+#include "fixed_mlp.h"
 
 class Instance;
 
 struct training_individual {
     std::vector<double> weights;  // chromosome: a set of neural network weights
     double ofv;                   // objective function value (quality of weights)
+    std::vector<double> instance_values; // BS solution length on each training instance
 };
 
 class MLP {
@@ -19,6 +24,7 @@ public:
     std::vector<Eigen::MatrixXd> bias_vectors;
     std::vector<Eigen::MatrixXd> weight_matrices;
     std::vector<Eigen::MatrixXd> activations;
+    std::shared_ptr<const FixedMLP> fixed_network; // specialized kernel for the stored weights, if any
 
     // training and validation data
     std::vector<Instance> training_instances;
@@ -29,6 +35,7 @@ public:
     int training_beam_width = 0;
     double training_time_limit = 0.0;
     double weight_limit = 1.0;
+    long long training_node_budget = 0; // beam nodes per training BS run instead of a time limit, 0 = none
 
     // feature/activation configuration
     int activation_function = 0;
@@ -40,17 +47,30 @@ public:
     int n_elites = 1;
     int n_mutants = 7;
     double elite_inheritance_probability = 0.5;
+    uint64_t seed;                // random streams of the trainer, clock-based unless set
+    int racing = 0;               // 0: full evaluations, 1: racing in instance order, 2: adaptive order
+    std::vector<int> training_bounds; // upper bound on the BS length of each training instance, for racing
+    int screening_beam_width = 0;  // beam width of the screening stage, 0 = no screening
+    int screening_instances = 0;   // training instances used for screening, 0 = all
+    double promotion_fraction = 0.25; // fraction of the screened individuals evaluated in full
 
     MLP();
 
     Eigen::VectorXd forward(const Eigen::VectorXd& x);
-    void apply_activation_function(Eigen::MatrixXd& x);
+    const Eigen::MatrixXd& forward_batch(const Eigen::Ref<const Eigen::MatrixXd>& X,
+                                         std::vector<Eigen::MatrixXd>& layer_outputs);
+    void apply_activation_function(Eigen::Ref<Eigen::MatrixXd> x);
 
     void store_weights(const std::vector<double>& weights);
     double calculate_validation_value(const std::vector<double>& weights);
 
     std::vector<double> Train();
-    void apply_decoder(training_individual& ind);
+    size_t apply_decoder(std::vector<training_individual>& individuals, size_t begin, size_t end,
+                         double cutoff = std::numeric_limits<double>::lowest(),
+                         const std::vector<int>& instance_order = {});
+    MLP with_weights(const std::vector<double>& weights) const;
+    std::vector<size_t> screen(std::vector<training_individual>& individuals, size_t begin, size_t end);
+    double training_run(Instance* inst, MLP& network, int beam_width) const;
 
     void write_weights_to_file(const std::vector<double>& weights, double time);
     void write_training_and_validation_values(std::ofstream& training_values_file,
@@ -1,171 +1,393 @@
-#include <iostream>
-#include <tuple>
 #include <algorithm>
-#include <map>
+#include <bit>
+#include <climits>
+#include <numeric>
 #include <vector>
-#include <set>
 #include "node.h"
 #include "instance.h"
 
-Node::Node(Instance* instance, std::vector<int>& left, std::vector<int>& ppos, std::vector<int>& rpos, Node* parent)
-    : inst(instance), parent(parent) {
-    
-    position = std::make_tuple(left, ppos, rpos);
-    l_v = (parent == nullptr) ? 0 : parent->l_v + 1;
-    f_value = l_v + heuristic_value;
+// Position hashes are sums of one 64-bit key per (string, position) entry, so a
+// child's hash follows from its parent's by only touching the entries that moved.
+static inline uint64_t entry_key(int entry, int pos) {
+    uint64_t x = (uint64_t(entry) << 32) ^ uint32_t(pos);
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
 }
 
-bool Node::domination_two_letters(rlcs_position& posA, rlcs_position& posB) {
+size_t NodeLevel::bytes() const {
+    return positions.size() * sizeof(int) + parents.size() * sizeof(int) +
+           letters.size() * sizeof(int) + hashes.size() * sizeof(uint64_t);
+}
+
+int* NodeLevel::push_back(int parent, int letter, uint64_t hash) {
+    parents.push_back(parent);
+    letters.push_back(letter);
+    hashes.push_back(hash);
+    positions.resize(positions.size() + stride);
+    return positions.data() + positions.size() - stride;
+}
+
+void NodeLevel::copy_nodes(const NodeLevel& other, size_t offset) {
+    std::copy(other.positions.begin(), other.positions.end(), positions.begin() + offset * stride);
+    std::copy(other.parents.begin(), other.parents.end(), parents.begin() + offset);
+    std::copy(other.letters.begin(), other.letters.end(), letters.begin() + offset);
+    std::copy(other.hashes.begin(), other.hashes.end(), hashes.begin() + offset);
+}
+
+void NodeLevel::resize(size_t n) {
+    positions.resize(n * stride);
+    parents.resize(n);
+    letters.resize(n);
+    hashes.resize(n);
+}
+
+void NodeLevel::clear() {
+    positions.clear();
+    parents.clear();
+    letters.clear();
+    hashes.clear();
+}
+
+NodePool::NodePool(Instance* instance)
+    : inst(instance), stride(instance->m + instance->p + instance->r) {
+
+    candidates.stride = stride;
+
+    // root node: nothing of any string consumed yet
+    NodeLevel root;
+    root.stride = stride;
+    std::vector<int> zeros(stride, 0);
+    std::fill_n(root.push_back(-1, -1, position_hash(zeros.data())), stride, 0);
+    levels.push_back(std::move(root));
+}
+
+uint64_t NodePool::position_hash(const int* position) const {
+    uint64_t hash = 0;
     for (int i = 0; i < inst->m; ++i)
-        if (std::get<0>(posA)[i] < std::get<0>(posB)[i])
-            return false;
+        hash += entry_key(i, position[i]);
+    for (int k = inst->m + inst->p; k < stride; ++k)
+        hash += entry_key(k, position[k]);
+    return hash;
+}
+
+void NodePool::commit(const NodeLevel& V_ext, const std::vector<int>& selected) {
+    NodeLevel level;
+    level.stride = stride;
+    level.positions.reserve(selected.size() * stride);
+    level.parents.reserve(selected.size());
+    level.letters.reserve(selected.size());
+    level.hashes.reserve(selected.size());
+
+    for (int idx : selected) {
+        int* row = level.push_back(V_ext.parents[idx], V_ext.letters[idx], V_ext.hashes[idx]);
+        std::copy_n(V_ext.position(idx), stride, row);
+    }
+
+    // the previous level has been expanded: keep only its back-pointers
+    NodeLevel& expanded = levels.back();
+    std::vector<int>().swap(expanded.positions);
+    std::vector<uint64_t>().swap(expanded.hashes);
+
+    levels.push_back(std::move(level));
+}
 
-    for (int j = 0; j < inst->p; ++j)
-        if (std::get<1>(posA)[j] > std::get<1>(posB)[j])
+size_t NodePool::bytes() const {
+    size_t total = 0;
+    for (const NodeLevel& level : levels)
+        total += level.bytes();
+    return total;
+}
+
+bool NodePool::is_complete(const int* position) const {
+    const int* lleft = position + inst->m;
+    const int* rleft = position + inst->m + inst->p;
+
+    for (int i = 0; i < inst->p; ++i)
+        if (lleft[i] < (int)inst->P[i].size())
             return false;
 
-    for (int i = 0; i < inst->r; ++i)
-        if (std::get<2>(posA)[i] <= std::get<2>(posB)[i])
+    for (int k = 0; k < inst->r; ++k)
+        if (rleft[k] >= (int)inst->R[k].size())
             return false;
 
     return true;
 }
 
-std::map<int, rlcs_position> Node::sigma_feasible_letters() {
-    std::vector<int> sigma;
-    for (int l = 0; l < inst->Sigma; ++l) {
-        bool feasible = true;
-        for (int i = 0; i < inst->m && feasible; ++i) {
-            if (std::get<0>(position)[i] >= (int)inst->S[i].size())
-                feasible = false;
-            else if (inst->occurances_string_pos_char[l][i][std::get<0>(position)[i]] <= 0)
-                feasible = false;
-        }
-        if (feasible)
-            sigma.push_back(l);
+std::vector<int> NodePool::export_solution(int l, int idx) const {
+    std::vector<int> solution;
+
+    // follow the parent links back to the root, collecting the appended letters
+    for (; l > 0; --l) {
+        solution.push_back(levels[l].letters[idx]);
+        idx = levels[l].parents[idx];
     }
 
-    std::map<int, rlcs_position> letters_next_positions;
-    std::vector<int> letters_to_remove;
+    std::reverse(solution.begin(), solution.end());
+    return solution;
+}
 
-    for (int lett : sigma) {
-        std::vector<int> pl_next, pleft_next, rleft_next;
+NodeExpander::NodeExpander(const NodePool& pool)
+    : pool(&pool), inst(pool.inst), stride(pool.stride) {
 
-        for (int i = 0; i < inst->m; ++i) {
-            int pl_i = inst->next_char_occurance_in_strings[lett][i][std::get<0>(position)[i]] + 1;
-            pl_next.push_back(pl_i);
-        }
+    children.stride = stride;
+    next_positions.resize(inst->Sigma * stride);
+    removed.resize(inst->Sigma);
+    rows.resize(inst->m);
+}
 
-        for (int j = 0; j < (int)inst->P.size(); ++j) {
-            int pj_left = std::get<1>(position)[j];
-            pleft_next.push_back(((int)inst->P[j].size() > pj_left && inst->P[j][pj_left] == lett) ? pj_left + 1 : pj_left);
-        }
+bool is_dominated(const int* posA, const int* posB, int m, int p, int stride) {
+    for (int i = 0; i < m; ++i)
+        if (posA[i] < posB[i])
+            return false;
 
-        for (int k = 0; k < (int)inst->R.size(); ++k) {
-            int rk_left = std::get<2>(position)[k];
-            rleft_next.push_back((inst->R[k][rk_left] == lett) ? rk_left + 1 : rk_left);
-            if (rleft_next[k] >= (int)inst->R[k].size())
-                letters_to_remove.push_back(lett);
-        }
+    for (int j = m; j < m + p; ++j)
+        if (posA[j] > posB[j])
+            return false;
 
-        letters_next_positions.emplace(lett, std::make_tuple(pl_next, pleft_next, rleft_next));
+    for (int k = m + p; k < stride; ++k)
+        if (posA[k] <= posB[k])
+            return false;
+
+    return true;
+}
+
+bool NodeExpander::domination_two_letters(const int* posA, const int* posB) const {
+    return is_dominated(posA, posB, inst->m, inst->p, stride);
+}
+
+void NodeExpander::sigma_feasible_letters(const int* position) {
+    const int m = inst->m, p = inst->p, r = inst->r;
+    const int* pl = position;
+    const int* pleft = position + m;
+    const int* rleft = position + m + p;
+
+    // table row of each S string at this node
+    for (int i = 0; i < m; ++i)
+        rows[i] = inst->s_offsets[i] + pl[i];
+
+    // letters occurring in the remaining part of every S string, in increasing order
+    feasible_letters.clear();
+    for (int w = 0; w < inst->mask_words; ++w) {
+        uint64_t available = ~uint64_t(0);
+        for (int i = 0; i < m && available; ++i)
+            available &= inst->remaining_letters_mask[rows[i] * inst->mask_words + w];
+
+        for (; available; available &= available - 1)
+            feasible_letters.push_back(w * 64 + std::countr_zero(available));
+    }
+
+    for (int lett : feasible_letters) {
+        int* next = next_positions.data() + lett * stride;
+        removed[lett] = 0;
+
+        for (int i = 0; i < m; ++i)
+            next[i] = inst->next_char_occurance_in_strings[rows[i] * inst->Sigma + lett] + 1;
+
+        for (int j = 0; j < p; ++j)
+            next[m + j] = ((int)inst->P[j].size() > pleft[j] && inst->P[j][pleft[j]] == lett) ? pleft[j] + 1 : pleft[j];
+
+        for (int k = 0; k < r; ++k) {
+            next[m + p + k] = (inst->R[k][rleft[k]] == lett) ? rleft[k] + 1 : rleft[k];
+            if (next[m + p + k] >= (int)inst->R[k].size())
+                removed[lett] = 1;
+        }
     }
 
     // embed structure check
-    for (auto& it : letters_next_positions) {
-        if (std::find(letters_to_remove.begin(), letters_to_remove.end(), it.first) != letters_to_remove.end())
+    for (int lett : feasible_letters) {
+        if (removed[lett])
             continue;
 
-        auto& pl_left = std::get<0>(it.second);
-        auto& pleft = std::get<1>(it.second);
+        const int* pl_left = next_positions.data() + lett * stride;
+        const int* pleft_next = pl_left + m;
 
         bool feasible = true;
-        for (int j = 0; j < (int)pleft.size() && feasible; ++j) {
-            for (int i = 0; i < inst->m && feasible; ++i) {
+        for (int j = 0; j < p && feasible; ++j) {
+            for (int i = 0; i < m && feasible; ++i) {
                 if (pl_left[j] < (int)inst->P[j].size() &&
-                    inst->remaining_patern_suffix_pos[i][j][pleft[j]] < pl_left[i]) {
+                    inst->remaining_patern_suffix_pos[(inst->p_offsets[j] + pleft_next[j]) * m + i] < pl_left[i]) {
                     feasible = false;
                 }
             }
         }
 
         if (!feasible)
-            letters_to_remove.push_back(it.first);
+            removed[lett] = 1;
     }
 
-    for (int letter : letters_to_remove)
-        letters_next_positions.erase(letter);
-
-    // domination pruning
-    for (auto itA = letters_next_positions.begin(); itA != letters_next_positions.end(); ++itA) {
-        for (auto itB = letters_next_positions.begin(); itB != letters_next_positions.end(); ++itB) {
-            if (itA != itB && domination_two_letters(itA->second, itB->second))
-                letters_to_remove.push_back(itA->first);
-        }
+    std::erase_if(feasible_letters, [this](int lett) { return removed[lett]; });
+
+    // domination pruning. A letter A is dominated by B only if A advances every R
+    // string and B does not (R_A[k] > R_B[k] for all k), so with R strings the only
+    // letter that can be dominated is the next letter shared by all of them.
+    int shared_r_letter = -1;
+    if (r > 0) {
+        shared_r_letter = inst->R[0][rleft[0]];
+        for (int k = 1; k < r && shared_r_letter >= 0; ++k)
+            if (inst->R[k][rleft[k]] != shared_r_letter)
+                shared_r_letter = -1;
     }
 
-    for (int letter : letters_to_remove)
-        letters_next_positions.erase(letter);
-
-    return letters_next_positions;
-}
-
-std::vector<Node*> Node::expansion() {
-    auto letters_next_positions = sigma_feasible_letters();
-    std::vector<Node*> node_extensions;
+    for (int lettA : feasible_letters) {
+        if (r > 0 && lettA != shared_r_letter)
+            continue;
 
-    for (auto& [lett, pos] : letters_next_positions) {
-        node_extensions.push_back(new Node(inst, std::get<0>(pos), std::get<1>(pos), std::get<2>(pos), this));
+        for (int lettB : feasible_letters) {
+            if (lettA != lettB && domination_two_letters(next_positions.data() + lettA * stride,
+                                                         next_positions.data() + lettB * stride))
+                removed[lettA] = 1;
+        }
+        dominated_letters += removed[lettA];
     }
 
-    return node_extensions;
+    std::erase_if(feasible_letters, [this](int lett) { return removed[lett]; });
 }
 
-bool Node::is_complete() {
-    auto& lleft = std::get<1>(position);
-    auto& rleft = std::get<2>(position);
+void NodeExpander::expansion(int l, int idx) {
+    const NodeLevel& level = pool->levels[l];
+    const int* position = level.position(idx);
+    sigma_feasible_letters(position);
 
-    for (int i = 0; i < (int)lleft.size(); ++i)
-        if (lleft[i] < (int)inst->P[i].size())
-            return false;
+    for (int lett : feasible_letters) {
+        const int* next = next_positions.data() + lett * stride;
 
-    for (int k = 0; k < (int)rleft.size(); ++k)
-        if (rleft[k] >= (int)inst->R[k].size())
-            return false;
+        // every S position advances, R positions only move where the letter matched
+        uint64_t hash = level.hashes[idx];
+        for (int i = 0; i < inst->m; ++i)
+            hash += entry_key(i, next[i]) - entry_key(i, position[i]);
+        for (int k = inst->m + inst->p; k < stride; ++k)
+            if (next[k] != position[k])
+                hash += entry_key(k, next[k]) - entry_key(k, position[k]);
 
-    return true;
+        int* child = children.push_back(idx, lett, hash);
+        std::copy_n(next, stride, child);
+    }
 }
 
-std::vector<int> Node::export_solution() {
-    std::vector<int> solution;
-    int next_in_s0 = std::get<0>(position)[0];
+NodeHashSet::NodeHashSet(int m, int p) : m(m), p(p), stamps(1024, 0), slots(1024) {}
 
-    if (next_in_s0 == 0)
-        return solution;
+void NodeHashSet::reset() {
+    count = 0;
+    if (++stamp == 0) { // wrapped around: stale stamps could look occupied
+        std::fill(stamps.begin(), stamps.end(), 0);
+        stamp = 1;
+    }
+}
 
-    int add_letter = inst->S[0][next_in_s0 - 1];
-    Node* node = parent;
+bool NodeHashSet::insert(const NodeLevel& level, int idx) {
+    if (2 * (count + 1) > slots.size())
+        grow(level);
 
-    if (node->l_v + 1 == l_v)
-        solution.push_back(add_letter);
+    const uint64_t hash = level.hashes[idx];
+    const int* position = level.position(idx);
+    const size_t mask = slots.size() - 1;
 
-    next_in_s0 = std::get<0>(node->position)[0];
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask) {
+        if (stamps[slot] != stamp) {
+            stamps[slot] = stamp;
+            slots[slot] = idx;
+            ++count;
+            return true;
+        }
 
-    while (next_in_s0 > 0) {
-        add_letter = node->inst->S[0][next_in_s0 - 1];
-        int l_v_child = node->l_v;
-        node = node->parent;
-        next_in_s0 = std::get<0>(node->position)[0];
+        int other = slots[slot];
+        if (level.hashes[other] != hash)
+            continue;
 
-        if (node->l_v + 1 == l_v_child)
-            solution.push_back(add_letter);
+        const int* other_position = level.position(other);
+        if (std::equal(position, position + m, other_position) &&
+            std::equal(position + m + p, position + level.stride, other_position + m + p))
+            return false;
     }
+}
 
-    std::reverse(solution.begin(), solution.end());
-    return solution;
+void NodeHashSet::grow(const NodeLevel& level) {
+    std::vector<int> occupied;
+    occupied.reserve(count);
+    for (size_t slot = 0; slot < slots.size(); ++slot)
+        if (stamps[slot] == stamp)
+            occupied.push_back(slots[slot]);
+
+    stamps.assign(2 * slots.size(), 0);
+    slots.resize(stamps.size());
+    stamp = 1;
+
+    const size_t mask = slots.size() - 1;
+    for (int idx : occupied) {
+        size_t slot = level.hashes[idx] & mask;
+        while (stamps[slot] == stamp)
+            slot = (slot + 1) & mask;
+        stamps[slot] = stamp;
+        slots[slot] = idx;
+    }
 }
 
-bool Node::operator>(const Node* other) {
-    return (f_value == other->f_value) ? (l_v > other->l_v) : (f_value > other->f_value);
+DominanceFilter::DominanceFilter(int m, int p, int stride, int n_references)
+    : m(m), p(p), stride(stride), n_references(n_references) {}
+
+void DominanceFilter::select_references(const NodeLevel& level, const std::vector<int>& nodes,
+                                        std::vector<char>& keep) {
+    keys.resize(level.size());
+    for (int idx : nodes) {
+        const int* position = level.position(idx);
+        keys[idx] = std::accumulate(position, position + m, 0LL);
+    }
+    auto by_key = [this](int a, int b) { return keys[a] != keys[b] ? keys[a] < keys[b] : a < b; };
+
+    // the references almost always come from the first few nodes in key order, so
+    // only a prefix of a few times n_references nodes is sorted at first
+    order = nodes;
+    size_t sorted = std::min(order.size(), size_t(4) * n_references);
+    std::nth_element(order.begin(), order.begin() + sorted, order.end(), by_key);
+    std::sort(order.begin(), order.begin() + sorted, by_key);
+
+    reference_rows.clear();
+    envelope.clear();
+    first_pending = 0;
+    while (first_pending < order.size() && reference_rows.size() < size_t(n_references) * stride) {
+        if (first_pending == sorted) {
+            std::sort(order.begin() + sorted, order.end(), by_key);
+            sorted = order.size();
+        }
+        int idx = order[first_pending++];
+        if (dominated(level, idx))
+            keep[idx] = 0;
+        else
+            reference_rows.insert(reference_rows.end(), level.position(idx), level.position(idx) + stride);
+    }
+
+    // the nodes left to check, back in level order for locality
+    decided.assign(level.size(), 0);
+    for (size_t i = 0; i < first_pending; ++i)
+        decided[order[i]] = 1;
+    order.resize(first_pending);
+    for (int idx : nodes)
+        if (!decided[idx])
+            order.push_back(idx);
+
+    // lowest S and R positions over the references: a node below them in any S or R
+    // string cannot be dominated by any reference
+    envelope.assign(stride, INT_MAX);
+    for (size_t row = 0; row < reference_rows.size(); row += stride)
+        for (int k = 0; k < stride; ++k)
+            envelope[k] = std::min(envelope[k], reference_rows[row + k]);
 }
 
+bool DominanceFilter::dominated(const NodeLevel& level, int idx) const {
+    const int* position = level.position(idx);
+    if (!envelope.empty()) {
+        for (int i = 0; i < m; ++i)
+            if (position[i] < envelope[i])
+                return false;
+        for (int k = m + p; k < stride; ++k)
+            if (position[k] <= envelope[k])
+                return false;
+    }
+
+    for (size_t row = 0; row < reference_rows.size(); row += stride)
+        if (is_dominated(position, reference_rows.data() + row, m, p, stride))
+            return true;
+    return false;
+}
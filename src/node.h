@@ -1,45 +1,135 @@
 #pragma once
 
 #include <vector>
-#include <map>
-#include <tuple>
+#include <cstddef>
+#include <cstdint>
 
 class Instance;
 
-using rlcs_position = std::tuple<std::vector<int>, std::vector<int>, std::vector<int>>;
+// Nodes of one beam search level, stored as a struct of arrays. The position of
+// node idx is the row positions[idx * stride, (idx + 1) * stride) holding its
+// S positions, then its P positions, then its R positions (stride = m + p + r).
+class NodeLevel {
+public:
+    int stride = 0;
+    std::vector<int> positions;           // flattened position rows
+    std::vector<int> parents;             // index of the parent node in the previous level
+    std::vector<int> letters;             // letter appended to the parent's partial solution
+    std::vector<uint64_t> hashes;         // hash of the (S positions, R positions) part of the row
+
+public:
+    size_t size() const { return parents.size(); }
+    bool empty() const { return parents.empty(); }
+
+    int* position(size_t idx) { return positions.data() + idx * stride; }
+    const int* position(size_t idx) const { return positions.data() + idx * stride; }
+
+    size_t bytes() const;                   // memory used by the stored nodes
+    int* push_back(int parent, int letter, uint64_t hash); // appends a node and returns its position row
+    void copy_nodes(const NodeLevel& other, size_t offset); // copies all nodes of other to [offset, offset + other.size())
+    void resize(size_t n);
+    void clear();                           // drops all nodes but keeps the buffers
+};
+
+// true if a node at position row posA is dominated by one at posB: B has consumed
+// no more of any S string, matched at least as much of every P string and strictly
+// less of every R string, so A cannot lead to a longer solution than B
+bool is_dominated(const int* posA, const int* posB, int m, int p, int stride);
 
-class Node {
+// Arena holding every level of a beam search run. levels[l] is the beam kept at
+// depth l and parent links are indices into the previous level. The extension
+// set of the level under construction is built in reused candidate levels and
+// only its selected nodes are committed as a new level. Once a level has been
+// expanded only its back-pointers (parents, letters) are kept, which is all
+// export_solution() needs.
+class NodePool {
 public:
     Instance* inst;
-    rlcs_position position; // tuple of (S positions, P positions, R positions)
-    Node* parent = nullptr; // pointer to parent node
+    int stride;
+    std::vector<NodeLevel> levels; // levels[l] = beam at depth l (levels[0] = root)
+    NodeLevel candidates;          // extension set of the next level, when merged from several expanders
 
-    int l_v = 0; // depth level
-    int f_value = 0;
-    double heuristic_value = 0.0; // heuristic value
-    bool complete = false; 
+public:
+    explicit NodePool(Instance* instance);
+
+    void commit(const NodeLevel& V_ext, const std::vector<int>& selected); // stores the selected nodes as a new level
+    size_t bytes() const;                                                  // memory used by the stored levels
+    std::vector<int> export_solution(int l, int idx) const;
+    bool is_complete(const int* position) const;
+    uint64_t position_hash(const int* position) const;
+};
 
-    std::vector<double> features; // features for the NN
+// Expands nodes of a NodePool into its own children level. Each thread taking
+// part in a level's expansion owns one, so expansions never share scratch space.
+class NodeExpander {
+public:
+    NodeLevel children;              // children produced since the last children.clear()
+    long long dominated_letters = 0; // feasible letters pruned by domination so far
 
 public:
+    explicit NodeExpander(const NodePool& pool);
+
+    void expansion(int l, int idx); // appends the children of node idx of level l to children
 
-Node(Instance* instance, std::vector<int>& left,
-         std::vector<int>& ppos, std::vector<int>& rpos,
-         Node* parent = nullptr);
+    bool domination_two_letters(const int* posA, const int* posB) const;
+    void sigma_feasible_letters(const int* position);
 
-    
-    std::vector<Node*> expansion();               
-    std::vector<int> export_solution();           
-    bool is_complete();                             
+private:
+    const NodePool* pool;
+    const Instance* inst;
+    int stride;
 
-    bool domination_two_letters(rlcs_position& posA, rlcs_position& posB);
-    std::map<int, rlcs_position> sigma_feasible_letters();
+    // scratch space of sigma_feasible_letters(), reused between expansions
+    std::vector<int> feasible_letters;   // letters surviving the feasibility and domination checks
+    std::vector<int> next_positions;     // one position row per letter of the alphabet
+    std::vector<char> removed;           // removed[letter] = letter was pruned
+    std::vector<size_t> rows;            // Instance table row of each S string at the expanded node
+};
+
+// Open-addressing set of extension set nodes, keyed by their (S positions,
+// R positions). The table is reused across levels: reset() only bumps a stamp
+// instead of clearing the slots, and the table only grows.
+class NodeHashSet {
+public:
+    NodeHashSet(int m, int p);
 
-    double greedy_function();                    
-    void set_up_prob_value(int k);                
+    void reset();                                // forgets all nodes, keeps the table
+    bool insert(const NodeLevel& level, int idx); // false if an equal node is already present
 
-    void print(); // debugging
+private:
+    int m, p;                    // S positions are row[0, m), R positions are row[m + p, stride)
+    uint32_t stamp = 1;          // slot i is occupied iff stamps[i] == stamp
+    size_t count = 0;
+    std::vector<uint32_t> stamps;
+    std::vector<int> slots;      // node index per slot
 
-    bool operator>(const Node* other);
+    void grow(const NodeLevel& level);
 };
 
+// Level-wide dominance filter for an extension set, across parents. Exact dominance
+// checks over all pairs are quadratic, so each node is only checked against a few
+// reference nodes: the first non-dominated ones in order of their sum of S positions,
+// i.e. those that have consumed the least of the S strings and are the likeliest to
+// dominate the others. Dominance is a strict order on nodes without duplicates, so
+// a dominated node always has a kept dominator.
+class DominanceFilter {
+public:
+    DominanceFilter(int m, int p, int stride, int n_references);
+
+    // picks the references among nodes and clears keep[idx] for the dominated nodes met
+    // on the way; the nodes still to check are then pending(0), ..., pending(n_pending() - 1)
+    void select_references(const NodeLevel& level, const std::vector<int>& nodes, std::vector<char>& keep);
+    size_t n_pending() const { return order.size() - first_pending; }
+    int pending(size_t i) const { return order[first_pending + i]; }
+
+    bool dominated(const NodeLevel& level, int idx) const; // by one of the references
+
+private:
+    int m, p, stride, n_references;
+    std::vector<int> order;            // references and nodes met while picking them, then pending nodes
+    std::vector<char> decided;         // decided[idx] = node idx was met while picking the references
+    std::vector<long long> keys;       // sum of S positions per node of the level
+    std::vector<int> reference_rows;   // position rows of the references, contiguous
+    std::vector<int> envelope;         // lowest position over the references, per string
+    size_t first_pending = 0;
+};